@@ -18,6 +18,9 @@ if [[ $1 = "clean" ]]; then
 	exit 0
 fi
 
+# optional: CFLAGS="-DUSE_SWITCH_DISPATCH" selects the switch interpreter
+# optional: CFLAGS="-DUSE_PROFILER" compiles in the profiler (profiler.h)
+# optional: CFLAGS="-DUSE_BUS_TRACE" compiles in the bus trace (bus_trace.h)
 DEBUG_FLAGS="-O0 -g -DDEBUG"
 RELEASE_FLAGS="-O2"
 if [[ $1 = "release" ]]; then
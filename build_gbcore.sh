@@ -0,0 +1,22 @@
+#!/bin/bash
+TARGET=libGbCore.a
+UNITYBUILD_CPP_FILE="src/gameboy/gbcore_ub.cpp"
+INCLUDE_DIRS="-Ilib/gamelib/src -Ilib/gbapu"
+DEBUG_FLAGS="-O0 -g -DDEBUG"
+RELEASE_FLAGS="-O2"
+if [[ $1 = "release" ]]; then
+	CFLAGS="$CFLAGS -std=c++11 $INCLUDE_DIRS $RELEASE_FLAGS"
+else
+	CFLAGS="$CFLAGS -std=c++11 $INCLUDE_DIRS $DEBUG_FLAGS"
+fi
+
+mkdir -p build
+c++ $CFLAGS -c ${UNITYBUILD_CPP_FILE} -o ${UNITYBUILD_CPP_FILE}.o
+EXIT_STATUS=$?
+if [ $EXIT_STATUS = 0 ]; then
+	rm -f build/$TARGET # prevents warning msg of compiler
+	ar rcs build/$TARGET ${UNITYBUILD_CPP_FILE}.o
+	rm ${UNITYBUILD_CPP_FILE}.o
+else
+	exit 1
+fi
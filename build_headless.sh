@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# builds gbemu-headless which only depends on gamelib/system and Gb Apu
+# usage: ./build_headless.sh [release|clean]
+
+TARGET="gbemu-headless"
+
+if [[ $1 = "clean" ]]; then
+	rm -f build/$TARGET build/trace-diff build/decode-bench build/libGbCore.a
+	exit 0
+fi
+
+# optional: CFLAGS="-DUSE_SWITCH_DISPATCH" selects the switch interpreter
+# optional: CFLAGS="-DUSE_PROFILER" compiles in the profiler (profiler.h)
+# optional: CFLAGS="-DUSE_BUS_TRACE" compiles in the bus trace (bus_trace.h)
+DEBUG_FLAGS="-O0 -g -DDEBUG"
+RELEASE_FLAGS="-O2"
+if [[ $1 = "release" ]]; then
+	CFLAGS="$CFLAGS -std=c++11 $RELEASE_FLAGS"
+else
+	CFLAGS="$CFLAGS -std=c++11 $DEBUG_FLAGS"
+fi
+LDFLAGS="-Lbuild"
+
+# gamelib
+INCLUDE_DIRS="-Ilib/gamelib/src"
+
+# Gb Apu
+INCLUDE_DIRS="$INCLUDE_DIRS -Ilib/gbapu"
+LIB_GBAPU="-lGbApu"
+if [ ! -f build/libGbApu.a ]; then
+	echo "building Gb Apu..."
+	./build_gbapu.sh
+	if [ $? = 1 ]; then
+		exit 1
+	fi
+fi
+
+# emulation core (always rebuilt, it's what we're measuring)
+LIB_GBCORE="-lGbCore"
+echo "building GameBoy core..."
+./build_gbcore.sh $1
+if [ $? = 1 ]; then
+	exit 1
+fi
+
+# final compiler flags
+CFLAGS="$CFLAGS $INCLUDE_DIRS"
+LDFLAGS="$LDFLAGS $LIB_GBCORE $LIB_GBAPU"
+
+mkdir -p build
+c++ $CFLAGS src/main_headless.cpp $LDFLAGS -o build/$TARGET
+
+# compares two bus traces
+c++ $CFLAGS src/trace_diff.cpp -o build/trace-diff
+
+# micro-benchmark of the pixel decoders
+c++ $CFLAGS src/decode_bench.cpp -o build/decode-bench
@@ -18,6 +18,7 @@ void App::init() {
 	memcpy(gb.memory.boot_rom, dmg_rom, dmg_rom_size);
 
 	gb.init();
+	rom_editor.AllowEdits = false; // the ROM is mapped read-only
 
 	glGenTextures(1, &lcd_tex);
 	glGenTextures(1, &tiles_tex);
@@ -26,8 +27,8 @@ void App::init() {
 	glBindTexture(GL_TEXTURE_2D, lcd_tex);
 	setFilterTexture2D(GL_NEAREST, GL_NEAREST);
 	setWrapTexture2D(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-	glTexImage2D(GL_TEXTURE_2D, /*level*/0, GL_RGB8, LCD_WIDTH, LCD_HEIGHT,
-		/*border*/0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	glTexImage2D(GL_TEXTURE_2D, /*level*/0, GL_RGBA8, LCD_WIDTH, LCD_HEIGHT,
+		/*border*/0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 
 	glBindTexture(GL_TEXTURE_2D, tiles_tex);
 	setFilterTexture2D(GL_NEAREST, GL_NEAREST);
@@ -50,6 +51,15 @@ void App::init() {
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+// stops the emulation, keeps the bus accesses leading up to the error
+void stopOnError(GameBoy *gb) {
+	gb->cpu.DEBUG_not_implemented_error = false;
+	gb->running = false;
+#ifdef USE_BUS_TRACE
+	if (gb->memory.bus_trace.enabled) gb->memory.bus_trace.write("error.trace");
+#endif
+}
+
 void cpuGUI(GameBoy *gb) {
 	CPU *cpu = &gb->cpu;
 
@@ -61,32 +71,53 @@ void cpuGUI(GameBoy *gb) {
 	if (ImGui::Button("Load")) {
 		gb->loadROM(rom_filepath);
 	}
-	if (gb->memory.sram_size > 0 && ImGui::Button("Write SRAM")) {
-		char sram_filepath[256];
-		strcpy(sram_filepath, rom_filepath);
-		strcpy(strrchr(sram_filepath, '.'), ".sav");
-		writeDataToFile(sram_filepath, gb->memory.sram, gb->memory.sram_size);
+	ImGui::Checkbox("Map SRAM to .sav", &gb->memory.map_sram); // on load
+	if ((gb->memory.sram_size > 0 || gb->memory.has_rtc) && !gb->memory.sram_mapped && ImGui::Button("Write SRAM")) {
+		gb->memory.writeSRAM();
 	}
 
 	if (ImGui::Button("Reset")) gb->reset();
 	ImGui::SameLine();
 	if (ImGui::Button(gb->running ? "Stop" : "Run")) {
 		gb->running = !gb->running;
+		gb->memory.watch_hit = -1; // continue past it
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Fast mode", &gb->fast_mode);
+	ImGui::SameLine();
+	ImGui::Checkbox("Block mode", &gb->block_mode);
+#ifdef CPU_JIT_X86
+	ImGui::SameLine();
+	ImGui::Checkbox("JIT", &gb->jit_mode);
+#endif
+	ImGui::SameLine();
+	ImGui::Checkbox("Skip idle loops", &gb->idle_loop_skip);
+	ImGui::SameLine();
+	ImGui::Checkbox("Scanline renderer", &gb->ppu.scanline_renderer);
+#ifdef USE_BUS_TRACE
+	bool bus_trace = gb->memory.bus_trace.enabled;
+	if (ImGui::Checkbox("Bus trace", &bus_trace)) gb->memory.enableBusTrace(bus_trace);
+	ImGui::SameLine();
+	if (ImGui::Button("Write bus.trace")) gb->memory.bus_trace.write("bus.trace");
+#endif
+	if (gb->idle_loop_skip) {
+		ImGui::SameLine();
+		ImGui::Text("(%llu cycles skipped)", (unsigned long long)gb->idle_loop.skipped_cycles);
 	}
 	if (ImGui::Button("Single Step")) gb->step();
 	if (ImGui::Button("Next Frame")) {
-		// run until vsync
+		// run until vsync (a step might span more than one PPU step)
+		u64 frame_count = gb->ppu.frame_count;
 		do {
 			if (gb->cpu.DEBUG_not_implemented_error) {
-				gb->cpu.DEBUG_not_implemented_error = false;
-				gb->running = false;
+				stopOnError(gb);
 				break;
 			}
-			gb->step();
-			if (gb->cpu.PC == gb->cpu.DEBUG_break_point) {
+			gb->stepBlock();
+			if (gb->cpu.PC == gb->cpu.DEBUG_break_point || gb->memory.watch_hit >= 0) {
 				gb->running = false;
 			}
-		} while (!gb->ppu.vsync);
+		} while (gb->ppu.frame_count == frame_count);
 	}
 	if (ImGui::Button("Next Scanline")) {
 		int ly = gb->memory.io.LY;
@@ -98,11 +129,10 @@ void cpuGUI(GameBoy *gb) {
 	if (ImGui::Button("Run to ")) {
 		while (gb->ppu.frame_count < break_frame) {
 			if (gb->cpu.DEBUG_not_implemented_error) {
-				gb->cpu.DEBUG_not_implemented_error = false;
-				gb->running = false;
+				stopOnError(gb);
 				break;
 			}
-			gb->step();
+			gb->stepBlock();
 		}
 	}
 	ImGui::SameLine();
@@ -115,6 +145,7 @@ void cpuGUI(GameBoy *gb) {
 	ImGui::Text("Address: 0x%04X", cpu->address);
 	ImGui::Text("Bus: 0x%02X", cpu->bus);
 
+	cpu->syncFlags();
 	ImGui::Text("Registers:");
 	ImGui::Text("A: %X", cpu->A); ImGui::SameLine();
 	ImGui::Text("F: %X", cpu->F);
@@ -134,7 +165,7 @@ void cpuGUI(GameBoy *gb) {
 
 	static u8 opcode = 0x00; // nop
 	if (cpu->state == CPU_STATE_FETCH) {
-		opcode = cpu->memory->load8(cpu->PC);
+		opcode = *cpu->memory->map(cpu->PC); // no IO or watchpoint side effects
 	}
 	ImGui::Text("instr: %s", cpu->instruction_infos[opcode].mnemonic);
 
@@ -151,6 +182,105 @@ void cpuGUI(GameBoy *gb) {
 	ImGui::End();
 }
 
+void watchpointGUI(Memory *memory) {
+	ImGui::Begin("Watchpoints");
+
+	static char str_first[8] = "C000";
+	static char str_last[8] = "C000";
+	static bool watch_read = false;
+	static bool watch_write = true;
+	static bool watch_execute = false;
+	ImGui::InputText("First", str_first, sizeof(str_first));
+	ImGui::InputText("Last", str_last, sizeof(str_last));
+	ImGui::Checkbox("Read", &watch_read);
+	ImGui::SameLine();
+	ImGui::Checkbox("Write", &watch_write);
+	ImGui::SameLine();
+	ImGui::Checkbox("Execute", &watch_execute);
+	if (ImGui::Button("Add")) {
+		u8 flags = (watch_read ? WATCH_READ : 0) | (watch_write ? WATCH_WRITE : 0)
+			| (watch_execute ? WATCH_EXECUTE : 0);
+		memory->addWatchpoint((u16)strtol(str_first, NULL, 16), (u16)strtol(str_last, NULL, 16), flags);
+	}
+
+	ImGui::Separator();
+	for (int i = 0; i < memory->watchpoint_count; i++) {
+		Watchpoint *w = &memory->watchpoints[i];
+		ImGui::PushID(i);
+		if (ImGui::Button("Remove")) memory->removeWatchpoint(i);
+		ImGui::PopID();
+		ImGui::SameLine();
+		ImGui::Text("0x%04X-0x%04X %c%c%c%s", w->first, w->last,
+			w->flags & WATCH_READ ? 'r' : '-', w->flags & WATCH_WRITE ? 'w' : '-',
+			w->flags & WATCH_EXECUTE ? 'x' : '-', i == memory->watch_hit ? " (hit)" : "");
+	}
+	if (memory->watch_hit >= 0) {
+		u8 flags = memory->watch_hit_flags;
+		ImGui::Text("Hit: %c 0x%04X = 0x%02X", flags == WATCH_WRITE ? 'w' : flags == WATCH_READ ? 'r' : 'x',
+			memory->watch_hit_address, memory->watch_hit_value);
+	}
+
+	ImGui::End();
+}
+
+#ifdef USE_PROFILER
+void profilerGUI(GameBoy *gb) {
+	Profiler *profiler = &gb->cpu.profiler;
+
+	ImGui::Begin("Profiler");
+
+	int interval = (int)profiler->sample_interval;
+	ImGui::InputInt("Sample every", &interval);
+	if (interval < 1) interval = 1;
+	profiler->sample_interval = (u32)interval;
+	ImGui::SameLine();
+	if (ImGui::Button("Clear")) profiler->reset(gb->memory.rom_size);
+
+	u64 total = profiler->totalCycles();
+	u32 indices[32];
+	ImGui::Separator();
+	ImGui::Text("Cycles by location:");
+	int count = total ? profiler->hottest(indices, ARRAY_COUNT(indices)) : 0;
+	for (int i = 0; i < count; i++) {
+		u32 location = indices[i];
+		u64 cycles = profiler->cycle_counts[location];
+		float percent = 100.0f * (float)cycles / (float)total;
+		u32 bank;
+		u16 pc;
+		if (!profiler->describe(location, &bank, &pc)) {
+			ImGui::Text("%-8s %5.1f%%", location == profiler->haltLocation() ? "HALT" : "IRQ", percent);
+		} else if (location < profiler->rom_size) {
+			ImGui::Text("%02X:%04X  %5.1f%%  %s", bank, pc, percent,
+				gb->cpu.instruction_infos[gb->memory.rom[location]].mnemonic);
+		} else {
+			ImGui::Text("%04X     %5.1f%%", pc, percent);
+		}
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Opcodes:");
+	count = Profiler::top(profiler->opcode_counts, 0x100, indices, ARRAY_COUNT(indices));
+	for (int i = 0; i < count; i++) {
+		ImGui::Text("%02X %-14s %llu", indices[i], gb->cpu.instruction_infos[indices[i]].mnemonic,
+			(unsigned long long)profiler->opcode_counts[indices[i]]);
+	}
+	count = Profiler::top(profiler->cb_opcode_counts, 0x100, indices, ARRAY_COUNT(indices));
+	for (int i = 0; i < count; i++) {
+		ImGui::Text("CB %02X %llu", indices[i], (unsigned long long)profiler->cb_opcode_counts[indices[i]]);
+	}
+
+	ImGui::Separator();
+	ImGui::Text("IO registers (reads, writes):");
+	for (int i = 0; i < 0x100; i++) {
+		if (!profiler->io_read_counts[i] && !profiler->io_write_counts[i]) continue;
+		ImGui::Text("FF%02X  %llu  %llu", i, (unsigned long long)profiler->io_read_counts[i],
+			(unsigned long long)profiler->io_write_counts[i]);
+	}
+
+	ImGui::End();
+}
+#endif
+
 void ppuGUI(PPU *ppu) {
 	IO *io = &ppu->gb->memory.io;
 	ImGui::Begin("PPU");
@@ -247,52 +377,26 @@ void App::updateGLTextures() {
 		{0x55,0x55,0x55},
 		{0x00,0x00,0x00}
 	};
-	u8 pixels[LCD_HEIGHT*LCD_WIDTH*3];
-
-#if 0
-	// same 2bit encoding as tile data
-	for (int y = 0; y < LCD_HEIGHT; y++) {
-		for (int lx = 0; lx < LCD_WIDTH/8; lx++) {
-			u8 llb = gb.ppu.framebuffer[y*LCD_WIDTH/4+2*lx+0];
-			u8 lhb = gb.ppu.framebuffer[y*LCD_WIDTH/4+2*lx+1];
-			for (int x = 0; x < 8; x++) {
-				int palette_idx = (llb >> (7-x)) & 0x1;
-				palette_idx |= ((lhb >> (7-x)) & 0x1) << 1;
+	// the same grays as RGBA (little endian)
+	const u32 lcd_colors[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+	u32 lcd_pixels[LCD_HEIGHT*LCD_WIDTH];
+	expandPixels(gb.ppu.framebuffer, LCD_HEIGHT*LCD_WIDTH, lcd_colors, lcd_pixels);
 
-				pixels[3*(y*LCD_WIDTH+8*lx+x)+0] = palette[palette_idx][0];
-				pixels[3*(y*LCD_WIDTH+8*lx+x)+1] = palette[palette_idx][1];
-				pixels[3*(y*LCD_WIDTH+8*lx+x)+2] = palette[palette_idx][2];
-			}
-		}
-	}
-#else
-	for (int y = 0; y < LCD_HEIGHT; y++) {
-		for (int x = 0; x < LCD_WIDTH; x++) {
-			int pixel = gb.ppu.framebuffer[y*LCD_WIDTH+x];
-			pixels[3*(y*LCD_WIDTH+x)+0] = palette[pixel][0];
-			pixels[3*(y*LCD_WIDTH+x)+1] = palette[pixel][1];
-			pixels[3*(y*LCD_WIDTH+x)+2] = palette[pixel][2];
-		}
-	}
-#endif
 	glBindTexture(GL_TEXTURE_2D, lcd_tex);
 	glTexSubImage2D(GL_TEXTURE_2D, /*level*/0, /*x*/0, /*y*/0,
-		LCD_WIDTH, LCD_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		LCD_WIDTH, LCD_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, lcd_pixels);
 	
-	int tile_adr = gb.memory.io.LCDC_tile_data ?
-		0x0000 : 0x1000;
+	TileCache *tile_cache = &gb.ppu.tile_cache;
+	int tile_base = gb.memory.io.LCDC_tile_data ? 0 : 256; // tile 0 in the cache
 
 	u8 tile_pixels[384*8*8*3];
 	for (int ti = 0; ti < 384; ti++) {
 		int ty = ti/16;
 		int tx = ti%16;
 		for (int y = 0; y < 8; y++) {
-			// line with high and low bits
-			u8 llb = gb.memory.vram[2*(8*ti+y)+0];
-			u8 lhb = gb.memory.vram[2*(8*ti+y)+1];
+			const u8 *row = tile_cache->row(gb.memory.vram, ti, y);
 			for (int x = 0; x < 8; x++) {
-				int palette_idx = (llb >> (7-x)) & 0x1;
-				palette_idx |= ((lhb >> (7-x)) & 0x1) << 1;
+				int palette_idx = row[x];
 
 				u8 *tile = &tile_pixels[3*(16*8*(8*ty+y)+8*tx+x)];
 				tile[0] = palette[palette_idx][0];
@@ -314,12 +418,9 @@ void App::updateGLTextures() {
 				gb.memory.vram[map_adr+ty*0x20+tx] :
 				((s8*)gb.memory.vram)[map_adr+ty*0x20+tx]; // signed
 			for (int y = 0; y < 8; y++) {
-				// line with high and low bits
-				u8 llb = gb.memory.vram[tile_adr + 2*(8*ti+y)+0];
-				u8 lhb = gb.memory.vram[tile_adr + 2*(8*ti+y)+1];
+				const u8 *row = tile_cache->row(gb.memory.vram, tile_base + ti, y);
 				for (int x = 0; x < 8; x++) {
-					int palette_idx = (llb >> (7-x)) & 0x1;
-					palette_idx |= ((lhb >> (7-x)) & 0x1) << 1;
+					int palette_idx = row[x];
 
 					u8 *map = &map_pixels[3*(32*8*(8*ty+y)+8*tx+x)];
 					map[0] = palette[palette_idx][0];
@@ -341,12 +442,9 @@ void App::updateGLTextures() {
 				gb.memory.vram[map_adr+ty*0x20+tx] :
 				((s8*)gb.memory.vram)[map_adr+ty*0x20+tx]; // signed
 			for (int y = 0; y < 8; y++) {
-				// line with high and low bits
-				u8 llb = gb.memory.vram[tile_adr + 2*(8*ti+y)+0];
-				u8 lhb = gb.memory.vram[tile_adr + 2*(8*ti+y)+1];
+				const u8 *row = tile_cache->row(gb.memory.vram, tile_base + ti, y);
 				for (int x = 0; x < 8; x++) {
-					int palette_idx = (llb >> (7-x)) & 0x1;
-					palette_idx |= ((lhb >> (7-x)) & 0x1) << 1;
+					int palette_idx = row[x];
 
 					u8 *map = &map_pixels[3*(32*8*(8*ty+y)+8*tx+x)];
 					map[0] = palette[palette_idx][0];
@@ -373,30 +471,43 @@ void App::update() {
 	if (gb.memory.rom) rom_editor.Draw("ROM Editor", gb.memory.rom, gb.memory.rom_size);
 	ram_editor.Draw("RAM Editor", gb.memory.ram, sizeof(gb.memory.ram));
 	hram_editor.Draw("HRAM Editor", gb.memory.hram, sizeof(gb.memory.hram));
+	int vram_edit = vram_editor.DataEditingAddr; // written in place by Draw
 	vram_editor.Draw("VRAM Editor", gb.memory.vram, sizeof(gb.memory.vram));
+	if (vram_edit >= 0) gb.ppu.tile_cache.invalidate(vram_edit);
 	cpuGUI(&gb);
+	watchpointGUI(&gb.memory);
+#ifdef USE_PROFILER
+	profilerGUI(&gb);
+#endif
 	ppuGUI(&gb.ppu);
 	ioGUI(&gb.memory.io);
 	oamWindow(&gb.memory.oam);
 
+	gb.button_right  = button_right.down();
+	gb.button_left   = button_left.down();
+	gb.button_up     = button_up.down();
+	gb.button_down   = button_down.down();
+	gb.button_a      = button_a.down();
+	gb.button_b      = button_b.down();
+	gb.button_select = button_select.down();
+	gb.button_start  = button_start.down();
+
 	gb.frame_begin_cycle_count = gb.cpu.cycle_count;
+	u64 frame_count = gb.ppu.frame_count;
 	while (gb.running) {
 		if (gb.cpu.DEBUG_not_implemented_error) {
-			gb.cpu.DEBUG_not_implemented_error = false;
-			gb.running = false;
+			stopOnError(&gb);
 			break;
 		}
-		gb.step();
-		if (gb.cpu.PC == gb.cpu.DEBUG_break_point) {
+		gb.stepBlock();
+		if (gb.cpu.PC == gb.cpu.DEBUG_break_point || gb.memory.watch_hit >= 0) {
 			gb.running = false;
 		}
-		if (gb.ppu.vsync) break;
+		if (gb.ppu.frame_count != frame_count) break; // vsync
 	}
-	u64 frame_cycle_count = gb.cpu.cycle_count - gb.frame_begin_cycle_count;
 
 	// fill audio buffers
-	bool stereo = gb.apu.end_frame(frame_cycle_count);
-	gb.audio_buffer.end_frame(frame_cycle_count, stereo);
+	gb.endAudioFrame();
 	blip_sample_t out_buf[4096];
 	int count = gb.audio_buffer.read_samples(out_buf, ARRAY_COUNT(out_buf));
 	static bool drain_buffer = false;
@@ -4,6 +4,16 @@ struct App {
 
 	GameBoy gb;
 
+	// input
+	ButtonState button_right;
+	ButtonState button_left;
+	ButtonState button_up;
+	ButtonState button_down;
+	ButtonState button_a;
+	ButtonState button_b;
+	ButtonState button_select;
+	ButtonState button_start;
+
 	GLuint lcd_tex;
 	GLuint tiles_tex;
 	GLuint bg_map_tex;
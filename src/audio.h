@@ -1,3 +1 @@
-const int AUDIO_SAMPLE_RATE = 44100;
-
 SDL_AudioDeviceID audio_device = 0; // the currently selected audio device
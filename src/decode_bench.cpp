@@ -0,0 +1,95 @@
+// micro-benchmark of the tile decoders and pixel expanders (pixel_decode.h),
+// checks them against the scalar versions first
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "system/defines.h"
+
+#include "gameboy/pixel_decode.h"
+#include "gameboy/pixel_decode.cpp"
+
+const int TILES = 384; // all of the tile data
+const int ROUNDS = 20000;
+
+static u8 tile_data[16*TILES];
+static u8 pixels[64*TILES];
+static u8 flipped[64*TILES];
+static u32 rgba[160*144];
+
+static bool checkDecoder(DecodeTileFn decode) {
+	u8 data[16], a[64], a_flipped[64], b[64], b_flipped[64];
+	for (int i = 0; i < 0x10000; i++) { // every low/high byte pair
+		for (int y = 0; y < 8; y++) {
+			data[2*y+0] = (u8)(i + 37*y);
+			data[2*y+1] = (u8)((i >> 8) + 11*y);
+		}
+		decodeTileScalar(data, a, a_flipped);
+		decode(data, b, b_flipped);
+		if (memcmp(a, b, 64) || memcmp(a_flipped, b_flipped, 64)) return false;
+	}
+	return true;
+}
+
+static bool checkExpander(ExpandPixelsFn expand) {
+	const u32 colors[4] = { 0x11223344, 0x55667788, 0x99AABBCC, 0xDDEEFF00 };
+	u8 input[161];
+	u32 a[161], b[161];
+	for (int i = 0; i < 161; i++) input[i] = (u8)(i*7 + i/5);
+	for (int count = 0; count <= 161; count++) { // the tail as well
+		expandPixelsScalar(input, count, colors, a);
+		expand(input, count, colors, b);
+		if (memcmp(a, b, count*sizeof(u32))) return false;
+	}
+	return true;
+}
+
+static void benchDecoder(const char *name, DecodeTileFn decode) {
+	if (!checkDecoder(decode)) {
+		printf("%-20s WRONG\n", name);
+		return;
+	}
+	auto begin = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS; round++) {
+		for (int t = 0; t < TILES; t++) decode(&tile_data[16*t], &pixels[64*t], &flipped[64*t]);
+		tile_data[round % sizeof(tile_data)] ^= pixels[round % sizeof(pixels)]; // keep the rounds
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	printf("%-20s %6.2f ns/tile\n", name, seconds * 1e9 / ((double)ROUNDS * TILES));
+}
+
+static void benchExpander(const char *name, ExpandPixelsFn expand) {
+	if (!checkExpander(expand)) {
+		printf("%-20s WRONG\n", name);
+		return;
+	}
+	const u32 colors[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+	auto begin = std::chrono::steady_clock::now();
+	for (int round = 0; round < ROUNDS/10; round++) {
+		expand(pixels, 160*144, colors, rgba);
+		pixels[round % sizeof(pixels)] ^= (u8)rgba[round % 160];
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	printf("%-20s %6.2f ns/line\n", name, seconds * 1e9 / ((double)ROUNDS/10 * 144));
+}
+
+int main() {
+	for (int i = 0; i < (int)sizeof(tile_data); i++) tile_data[i] = (u8)(i * 2654435761u >> 13);
+
+	printf("decode 2bpp tile (64 pixels + mirrored):\n");
+	benchDecoder("scalar", decodeTileScalar);
+#ifdef PIXEL_DECODE_X86
+	benchDecoder("sse2", decodeTileSSE2);
+#endif
+
+	printf("expand 160 pixels to RGBA:\n");
+	benchExpander("scalar", expandPixelsScalar);
+#ifdef PIXEL_DECODE_X86
+	if (__builtin_cpu_supports("ssse3")) benchExpander("ssse3", expandPixelsSSSE3);
+	else printf("%-20s no cpu support\n", "ssse3");
+#endif
+	return 0;
+}
@@ -0,0 +1,151 @@
+BlockCache::~BlockCache() {
+	if (blocks) delete [] blocks;
+	if (ram_code) delete ram_code;
+}
+
+static bool endsBlock(u8 opcode) {
+	switch (opcode) {
+	case 0x10: case 0x76: // STOP HALT
+	case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+	case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+	case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+	case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET
+	case 0xC7: case 0xCF: case 0xD7: case 0xDF: // RST
+	case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+		return true;
+	default:
+		return false;
+	}
+}
+
+const DecodedOp *BlockCache::fetch(CPU *cpu, u16 pc) {
+	if (block && pc == next_pc && block_index < block->op_count) {
+		DEBUG_hit_count++;
+		const DecodedOp *op = &block->ops[block_index++];
+		next_pc = pc + op->length;
+		return op;
+	}
+	block = nullptr;
+	BUS_TRACE(if (cpu->memory->bus_trace.enabled) return nullptr;) // fetch over the bus
+
+	// find the code and the end of its region (a block doesn't cross it)
+	Memory *memory = cpu->memory;
+	u16 adr = pc;
+	u32 bank;
+	const u8 *code;
+	u16 end;
+	if (memory->dma_active) { // fetches have to go over the (blocked) bus
+		return nullptr;
+	} else if (memory->watched_pages[pc >> PAGE_SHIFT] & WATCH_EXECUTE) {
+		return nullptr; // fetched over the bus to hit the watchpoint
+	} else if (pc < ADR_VRAM && !memory->rom) {
+		return nullptr;
+	} else if (pc < ADR_ROM_BANK1) {
+		if (pc < SIZE_BOOT_ROM && !memory->io.BOOT) return nullptr;
+		bank = 0;
+		code = memory->rom_bank0;
+		end = ADR_ROM_BANK1;
+	} else if (pc < ADR_VRAM) {
+		bank = (memory->rom_bank1 - memory->rom) / SIZE_ROM_BANK;
+		code = memory->rom_bank1 - ADR_ROM_BANK1;
+		end = ADR_VRAM;
+	} else if (pc >= ADR_RAM_INTERNAL_BANK0 && pc < ADR_OAM) {
+		if (adr >= ADR_RAM_INTERNAL_MIRROR) adr -= SIZE_RAM; // echo
+		bank = BLOCK_BANK_RAM;
+		code = memory->ram - ADR_RAM_INTERNAL_BANK0;
+		end = ADR_RAM_INTERNAL_BANK0 + SIZE_RAM;
+	} else {
+		return nullptr; // VRAM, SRAM, OAM, IO and HRAM are never cached
+	}
+
+	if (!blocks) {
+		blocks = new Block[BLOCK_CACHE_SIZE];
+		ram_code = new RAMCode();
+		invalidateAll();
+	}
+	u32 key = bank<<16 | adr;
+	Block *b = &blocks[(adr ^ (bank * 0x9E7)) & (BLOCK_CACHE_SIZE-1)];
+	if (b->key != key || (bank == BLOCK_BANK_RAM && isStale(b))) decode(b, cpu, key, code, adr, end);
+	if (b->op_count == 0) return nullptr;
+
+	block = b;
+	block_index = 1;
+	next_pc = pc + b->ops[0].length;
+	return &b->ops[0];
+}
+
+void BlockCache::decode(Block *b, CPU *cpu, u32 key, const u8 *code, u16 pc, u16 end) {
+	DEBUG_decode_count++;
+	b->key = key;
+	b->op_count = 0;
+	b->jit = nullptr;
+	b->runs = 0;
+	u16 begin = pc;
+	while (b->op_count < BLOCK_MAX_OPS) {
+		u8 opcode = code[pc];
+		int length = opcode == 0xCB ? 2 : cpu->instruction_infos[opcode].length;
+		if (length == 0 || pc + length > end) break; // illegal or crossing the region
+		if (cpu->memory->watched_pages[(pc + length - 1) >> PAGE_SHIFT] & WATCH_EXECUTE) break;
+		DecodedOp *op = &b->ops[b->op_count++];
+		op->opcode = opcode;
+		op->length = length;
+		op->operand[0] = length > 1 ? code[pc+1] : 0;
+		op->operand[1] = length > 2 ? code[pc+2] : 0;
+		pc += length;
+		if (endsBlock(opcode)) break;
+	}
+	b->size = pc - begin;
+
+	if ((key>>16) == BLOCK_BANK_RAM) {
+		// an empty block (illegal opcode) covers its first byte
+		int first = begin - ADR_RAM_INTERNAL_BANK0;
+		int last = first + (b->size ? b->size : 1) - 1;
+		for (int offset = first; offset <= last; offset++) {
+			ram_code->bytes[offset>>3] |= 1 << (offset&7);
+		}
+		b->generations[0] = ram_code->page_generations[first >> PAGE_SHIFT];
+		b->generations[1] = ram_code->page_generations[last >> PAGE_SHIFT];
+		for (int page = first >> PAGE_SHIFT; page <= last >> PAGE_SHIFT; page++) {
+			if (ram_code->pages[page]) continue;
+			ram_code->pages[page] = true;
+			updateRAMPage(cpu->memory, page); // stores have to go through onRAMWrite
+		}
+	}
+}
+
+bool BlockCache::isStale(const Block *b) {
+	int first = (b->key & 0xFFFF) - ADR_RAM_INTERNAL_BANK0;
+	int last = first + (b->size ? b->size : 1) - 1;
+	return b->generations[0] != ram_code->page_generations[first >> PAGE_SHIFT]
+		|| b->generations[1] != ram_code->page_generations[last >> PAGE_SHIFT];
+}
+
+void BlockCache::updateRAMPage(Memory *memory, int page) {
+	int first = (ADR_RAM_INTERNAL_BANK0 >> PAGE_SHIFT) + page;
+	memory->updatePages(first, first);
+	int echo = (ADR_RAM_INTERNAL_MIRROR >> PAGE_SHIFT) + page;
+	if (echo < (ADR_OAM >> PAGE_SHIFT)) memory->updatePages(echo, echo);
+}
+
+void BlockCache::onRAMWrite(Memory *memory, u16 address) {
+	int offset = (address - ADR_RAM_INTERNAL_BANK0) % SIZE_RAM;
+	if (!ram_code || !(ram_code->bytes[offset>>3] & (1 << (offset&7)))) return; // data next to code
+	// drop the blocks of the page, the others stay valid
+	int page = offset >> PAGE_SHIFT;
+	ram_code->page_generations[page]++;
+	memset(&ram_code->bytes[(page << PAGE_SHIFT) >> 3], 0, PAGE_SIZE >> 3);
+	ram_code->pages[page] = false;
+	block = nullptr;
+	updateRAMPage(memory, page);
+}
+
+void BlockCache::invalidateAll() {
+	if (blocks) {
+		for (int i = 0; i < BLOCK_CACHE_SIZE; i++) blocks[i].key = BLOCK_KEY_INVALID;
+	}
+	block = nullptr;
+	if (ram_code) {
+		memset(ram_code->bytes, 0, sizeof(ram_code->bytes));
+		memset(ram_code->pages, 0, sizeof(ram_code->pages));
+	}
+}
@@ -0,0 +1,67 @@
+// predecoded straight-line code for the fast mode
+// blocks are keyed on (ROM bank, PC) so they survive MBC bank switches,
+// code in WRAM is cached as well, a store to one of its bytes drops the
+// blocks of that 256 byte page
+
+const int BLOCK_MAX_OPS    = 32;
+const int BLOCK_CACHE_SIZE = 4096; // direct mapped, power of two
+
+const u32 BLOCK_KEY_INVALID = 0xFFFFFFFF;
+const u32 BLOCK_BANK_RAM    = 0x1000; // above any ROM bank
+
+struct DecodedOp {
+	u8 opcode;
+	u8 length; // in bytes
+	u8 operand[2]; // immediate bytes (CB: the second opcode byte)
+};
+
+struct JitBlock;
+
+struct Block {
+	u32 key; // bank<<16 | pc
+	int op_count;
+	int size; // in bytes
+	u32 generations[2]; // WRAM: page_generations of the first and last page
+	JitBlock *jit; // native code, see jit.h
+	int runs; // until it's compiled, -1: never
+	DecodedOp ops[BLOCK_MAX_OPS];
+};
+
+struct CPU;
+struct Memory;
+
+// WRAM bytes that were decoded into blocks, stores to their pages take
+// the slow path so that onRAMWrite sees them
+struct RAMCode {
+	u8 bytes[SIZE_RAM>>3]; // bitmap
+	bool pages[SIZE_RAM>>PAGE_SHIFT];
+	u32 page_generations[SIZE_RAM>>PAGE_SHIFT]; // bumped on a code write
+};
+
+struct BlockCache {
+	// allocated on first use, the accurate mode never needs them
+	Block *blocks = nullptr;
+	RAMCode *ram_code = nullptr;
+
+	// current position, the next op is used as long as PC follows it
+	Block *block = nullptr;
+	int block_index = 0;
+	u16 next_pc = 0;
+
+	// debug
+	u64 DEBUG_hit_count = 0;
+	u64 DEBUG_decode_count = 0;
+
+	~BlockCache();
+
+	const DecodedOp *fetch(CPU *cpu, u16 pc); // nullptr: execute uncached
+	void invalidateAll();
+	void onRAMWrite(Memory *memory, u16 address); // address in 0xC000-0xFDFF
+	void resetCursor() { block = nullptr; }
+	bool isCodePage(int page) const { return ram_code && ram_code->pages[page]; } // WRAM page
+
+private:
+	void decode(Block *block, CPU *cpu, u32 key, const u8 *code, u16 pc, u16 end);
+	bool isStale(const Block *block);
+	void updateRAMPage(Memory *memory, int page); // and its echo
+};
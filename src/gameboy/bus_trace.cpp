@@ -0,0 +1,17 @@
+#ifdef USE_BUS_TRACE
+
+bool BusTrace::write(const char *filepath) {
+	FILE *file = fopen(filepath, "wb");
+	if (!file) return false;
+	u64 first = count > BUS_TRACE_SIZE ? count - BUS_TRACE_SIZE : 0;
+	fwrite("GBTRACE1", 1, 8, file);
+	fwrite(&first, sizeof(first), 1, file);
+	for (u64 i = first; i < count; i++) {
+		fwrite(&accesses[i & (BUS_TRACE_SIZE-1)], sizeof(BusAccess), 1, file);
+	}
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
+
+#endif
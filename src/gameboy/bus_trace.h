@@ -0,0 +1,46 @@
+// bus access trace, compiled in with -DUSE_BUS_TRACE
+// while enabled all page table entries are nullptr, so every load8/store8
+// takes the slow path and is recorded into a fixed ring of the last
+// BUS_TRACE_SIZE accesses. the block cache is off as well, opcode fetches
+// go over the bus in every mode. compare two dumps with trace_diff.cpp
+
+#ifdef USE_BUS_TRACE
+#define BUS_TRACE(STATEMENT) STATEMENT
+#else
+#define BUS_TRACE(STATEMENT)
+#endif
+
+const int BUS_TRACE_SIZE = 1<<16; // power of two
+const u8 BUS_ACCESS_WRITE = 0x1;
+
+// file: "GBTRACE1", u64 index of the first access, then the accesses
+// oldest first, all little endian
+struct BusAccess {
+	u64 cycle;
+	u16 pc;
+	u16 address;
+	u8 value;
+	u8 flags; // BUS_ACCESS_*
+	u8 padding[2];
+};
+
+#ifdef USE_BUS_TRACE
+
+struct BusTrace {
+	bool enabled = false; // see Memory::enableBusTrace
+	u64 count = 0; // accesses recorded so far, the ring keeps the last ones
+	BusAccess accesses[BUS_TRACE_SIZE]; // inline, recording never allocates
+
+	void record(u64 cycle, u16 pc, u16 address, u8 value, u8 flags) {
+		BusAccess *a = &accesses[count++ & (BUS_TRACE_SIZE-1)];
+		a->cycle = cycle;
+		a->pc = pc;
+		a->address = address;
+		a->value = value;
+		a->flags = flags;
+		a->padding[0] = a->padding[1] = 0;
+	}
+	bool write(const char *filepath);
+};
+
+#endif
@@ -1,3 +1,16 @@
+const char *const cpu_state_names[] = {
+	[CPU_STATE_FETCH]   = "fetch",
+	[CPU_STATE_IDLE0]   = "idle0",
+	[CPU_STATE_IDLE1]   = "idle1",
+	[CPU_STATE_EXECUTE] = "execute",
+
+	[CPU_STATE_MEMORY_LOAD]  = "mem load",
+	[CPU_STATE_MEMORY_STORE] = "mem store",
+	[CPU_STATE_READ_PC]      = "read pc",
+	[CPU_STATE_STALL]        = "stall",
+	[CPU_STATE_OP2]          = "op2"
+};
+
 void CPU::reset() {
 	cycle_count = 0;
 	halted = false;
@@ -6,8 +19,11 @@ void CPU::reset() {
 	bus = 0;
 	instruction = nullptr;
 	condition = false;
+	immediate = nullptr;
+	PROFILE(profiler.reset(memory->rom_size);)
 
 	AF = 0;
+	lazy_op = LAZY_NONE;
 	BC = 0;
 	DE = 0;
 	HL = 0;
@@ -18,20 +34,30 @@ void CPU::reset() {
 }
 
 void CPU::step() {
-	// update timers
-	// CPU_HZ = 1<<22; 4 MiHz
-	// DIV_HZ = 1<<14; 16 KiH
-	if ((cycle_count&0xFF) == 0)  memory->io.DIV++;
+#ifdef USE_SWITCH_DISPATCH
+	stepInstruction<false>();
+#else
+	PROFILE(u64 profile_begin = cycle_count;)
+	stepMicroOp();
+	PROFILE(if (halted) profiler.onHalt();)
+	PROFILE(profiler.onCycles(cycle_count - profile_begin);)
+#endif
+}
+
+int CPU::timerShift() {
+	static const int shifts[4] = {10, 4, 6, 8}; // 1<<12, 1<<18, 1<<16, 1<<14 Hz
+	return shifts[memory->io.TAC_clock];
+}
+
+// DIV and TIMA ticks in [begin, end)
+void CPU::updateTimers(u64 cycle_begin, u64 cycle_end) {
+	memory->io.DIV += ((cycle_end + 0xFF) >> 8) - ((cycle_begin + 0xFF) >> 8);
 
 	if (memory->io.TAC_stop == 1) { // timer running
-		int period = 0;
-		switch (memory->io.TAC_clock) {
-			case 0: period = 1<<10; break; // 1<<12 Hz
-			case 1: period = 1<<4; break; // 1<<18 Hz
-			case 2: period = 1<<6; break; // 1<<16 Hz
-			case 3: period = 1<<8; break; // 1<<14 Hz
-		}
-		if ((cycle_count&(period-1)) == 0) {
+		int shift = timerShift();
+		u64 round = (1 << shift) - 1;
+		u64 ticks = ((cycle_end + round) >> shift) - ((cycle_begin + round) >> shift);
+		for (; ticks > 0; ticks--) {
 			if (memory->io.TIMA == 0xFF) {
 				memory->io.TIMA = memory->io.TMA; // reset
 				memory->io.IF_timer = 1; // raise interrupt
@@ -41,6 +67,33 @@ void CPU::step() {
 			}
 		}
 	}
+}
+
+u64 CPU::nextTimerOverflow(u64 cycle) {
+	if (memory->io.TAC_stop != 1) return EVENT_NEVER;
+	int shift = timerShift();
+	u64 round = (1 << shift) - 1;
+	u64 first_tick = (cycle + round) & ~round;
+	return first_tick + ((u64)(0xFF - memory->io.TIMA) << shift);
+}
+
+// accurate mode: the access happens one cycle into the current M-cycle, the
+// PPU and timers catch up to it first if it could observe them
+u8 CPU::syncedLoad8(u16 adr) {
+	if (needsSync(adr)) memory->gb->catchUp();
+	return memory->load8(adr);
+}
+
+void CPU::syncedStore8(u16 adr, u8 value) {
+	if (needsSync(adr)) memory->gb->catchUp();
+	memory->store8(adr, value);
+	if ((adr >= ADR_IO && adr < ADR_HRAM) || adr == ADR_IE) {
+		memory->gb->scheduler.schedule(EVENT_SYNC, cycle_count);
+	}
+}
+
+void CPU::stepMicroOp() {
+	syncFlags(); // the micro-ops work on F directly
 
 	cycle_count++;
 
@@ -49,6 +102,7 @@ void CPU::step() {
 
 	switch (old_state) {
 	case CPU_STATE_FETCH:
+		if (cycle_count > memory->gb->scheduler.next) memory->gb->catchUp(); // IRQs
 		// TODO: handle more IRQs
 		if (IME) {
 			if (memory->io.IE_vblank && memory->io.IF_vblank) {
@@ -75,18 +129,19 @@ void CPU::step() {
 			}
 		}
 		if (!halted) {
-			bus = memory->load8(PC++);
+			bus = syncedLoad8(PC++);
 			instruction = instructions[bus];
+			PROFILE(profiler.onFetch(memory, PC-1, bus);)
 		}
 		break;
 	case CPU_STATE_MEMORY_LOAD:
-		bus = memory->load8(address);
+		bus = syncedLoad8(address);
 		break;
 	case CPU_STATE_MEMORY_STORE:
-		memory->store8(address, bus);
+		syncedStore8(address, bus);
 		break;
 	case CPU_STATE_READ_PC:
-		bus = memory->load8(PC++);
+		bus = syncedLoad8(PC++);
 		break;
 	case CPU_STATE_STALL:
 		instruction = &CPU::nop;
@@ -95,6 +150,7 @@ void CPU::step() {
 	}
 
 	cycle_count += 2;
+	PROFILE(if (old_state == CPU_STATE_FETCH && instruction == &CPU::irq) profiler.onIRQ();)
 
 	state = CPU_STATE_FETCH;
 	if (instruction == nullptr) {
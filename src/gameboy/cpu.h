@@ -11,21 +11,26 @@ enum CPUState {
 	CPU_STATE_OP2
 };
 
-const char *cpu_state_names[] = {
-	[CPU_STATE_FETCH]   = "fetch",
-	[CPU_STATE_IDLE0]   = "idle0",
-	[CPU_STATE_IDLE1]   = "idle1",
-	[CPU_STATE_EXECUTE] = "execute",
-
-	[CPU_STATE_MEMORY_LOAD]  = "mem load",
-	[CPU_STATE_MEMORY_STORE] = "mem store",
-	[CPU_STATE_READ_PC]      = "read pc",
-	[CPU_STATE_STALL]        = "stall",
-	[CPU_STATE_OP2]          = "op2"
+extern const char *const cpu_state_names[];
+
+// how to compute F from the lazy flags state
+enum LazyOp {
+	LAZY_NONE, // F is up to date
+	LAZY_ADD, // Z from result, N=0, H from operands, C from result bit 8
+	LAZY_SUB, // same with N=1
+	LAZY_AND, // Z and C from result, N=0, H=1
+	LAZY_OR   // Z and C from result, N=0, H=0
 };
 
 struct Memory;
 
+struct InstructionInfo {
+	const char *mnemonic;
+	int length; // in bytes
+	int cycles; // clock cycles (CB: only prefix and operand, conditional: not taken)
+	int cycles_branch; // clock cycles if the condition is met, 0 if unconditional
+};
+
 // SHARP LR35902
 struct CPU {
 	typedef void (CPU::*Instruction)();
@@ -55,11 +60,21 @@ struct CPU {
 
 	u8 IME; // interrupt master enable (only set by ei and di instruction)
 
+	// lazy flags (cpu_switch.cpp), call syncFlags before reading F
+	u8 lazy_op; // LazyOp
+	u8 lazy_a, lazy_b; // operands
+	u16 lazy_res; // bit 8: carry
+
 	u64 cycle_count;
 	bool halted;
 
 	Memory *memory;
 
+#ifdef USE_PROFILER
+	Profiler profiler;
+#endif
+	const u8 *immediate = nullptr; // operands of the current predecoded op
+
 	CPUState state;
 	u16 address; // current address
 	u8 bus; // current byte on bus
@@ -72,7 +87,46 @@ struct CPU {
 	int DEBUG_break_point = 0xFFFF;
 
 	void reset();
-	void step();
+	void step(); // USE_SWITCH_DISPATCH: one instruction, otherwise one M-cycle
+
+	int timerShift(); // log2 of the TIMA period in cycles, from TAC
+	void updateTimers(u64 cycle_begin, u64 cycle_end); // ticks in [begin, end)
+	u64 nextTimerOverflow(u64 cycle); // tick at which TIMA overflows
+	u8 syncedLoad8(u16 adr); // accurate mode bus access
+	void syncedStore8(u16 adr, u8 value);
+	void stepMicroOp(); // cpu_instructions.h state machine
+
+	// cpu_switch.cpp
+	u8 flagZ();
+	u8 flagC();
+	void syncFlags(); // compute F from the lazy flags
+	// FAST=true: no PPU/timer stepping, cycles from instruction_infos
+	template <bool FAST> void stepInstruction();
+	template <bool FAST> void executeOpcode(u8 opcode);
+	template <bool FAST> void stepPrefixCB(u8 opcode);
+	void addFastCycles(u8 opcode);
+	void cycleNext();
+	template <bool FAST> u8 cycleRead(u16 adr);
+	template <bool FAST> u8 cycleReadPC(); // immediate operand
+	template <bool FAST> void cycleWrite(u16 adr, u8 value);
+	template <bool FAST> void cycleIdle();
+
+	// cpu_threaded.cpp
+	bool runBlock(); // false: next instruction needs stepInstruction<true>
+	template <int OPCODE> void executeThreaded();
+	static const Instruction threaded_ops[0x100];
+
+	// cpu_jit.cpp
+	bool runJit(Block *block, const DecodedOp *op); // false: run it threaded
+	JitBlock *compileBlock(Block *block);
+	void flushJit();
 
 	#include "cpu_instructions.h"
 };
+
+#ifndef USE_PROFILER
+// registers and the state of the current instruction, nothing that grows
+// with the caches (see GameBoy::block_cache)
+static_assert(sizeof(CPU) <= 128, "CPU is meant to hold register state only");
+#endif
+
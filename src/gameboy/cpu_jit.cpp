@@ -0,0 +1,1213 @@
+// x86-64 code generator for the block mode (see jit.h)
+// a block is compiled once it ran JIT_HOT_RUNS times. the code counts the
+// cycles of the ops it ran at compile time and only adds them to cycle_count
+// when it calls into the interpreter or leaves. after every op it compares
+// them with Jit::budget and leaves where the threaded code would break, so
+// IRQs, PPU and timers see the same instruction boundaries as in fast mode
+//
+// host registers while a block runs (all callee-saved):
+//   rbx: CPU  rbp: BC  r12: DE  r13: HL  r14: SP  r15: A
+// the pairs are zero-extended 16 bit values and A a zero-extended byte.
+// F and the lazy flags stay in the CPU, the compiler tracks the LazyOp the
+// ops before have set so that Z and C are tested without looking at lazy_op
+
+#ifdef CPU_JIT_X86
+
+enum X86Reg {
+	X86_RAX, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+	X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15
+};
+
+// condition codes, flipping the lowest bit negates them
+enum X86Cond { X86_B = 0x2, X86_AE = 0x3, X86_E = 0x4, X86_NE = 0x5, X86_L = 0xC };
+
+// the /r extension of the group 1 (ALU) and group 2 (shift) opcodes
+enum X86Alu { X86_ADD, X86_OR, X86_ADC, X86_SBB, X86_AND, X86_SUB, X86_XOR, X86_CMP };
+enum X86Shift { X86_SHL = 4, X86_SHR = 5 };
+
+// which operands of an instruction are byte registers (spl, bpl, sil and
+// dil need a REX prefix, without one they encode ah, ch, dh and bh)
+const int X86_BYTE_REG = 1;
+const int X86_BYTE_RM  = 2;
+
+const int JIT_HOT  = 0; // straight-line code of the ops
+const int JIT_COLD = 1; // slow paths and early exits, placed behind the hot code
+const int JIT_MAX_LABELS = 512;
+const int JIT_MAX_FIXUPS = 512;
+
+struct JitFixup {
+	int section;
+	int offset; // of the rel32
+	int label; // -1: target
+	const u8 *target;
+};
+
+// operands are registers or [base + index*scale + disp32]
+struct JitAssembler {
+	u8 *hot; // in the buffer, the cold code is copied behind it by link
+	u8 cold[JIT_MAX_BLOCK_SIZE];
+	int sizes[2] = { 0, 0 };
+	int section = JIT_HOT;
+	bool overflow = false;
+
+	int label_sections[JIT_MAX_LABELS];
+	int label_offsets[JIT_MAX_LABELS];
+	int label_count = 0;
+	JitFixup fixups[JIT_MAX_FIXUPS];
+	int fixup_count = 0;
+
+	void byte(u8 value) {
+		if (sizes[section] == JIT_MAX_BLOCK_SIZE) {
+			overflow = true;
+			return;
+		}
+		(section == JIT_HOT ? hot : cold)[sizes[section]++] = value;
+	}
+	void word(u16 value) { byte(value); byte(value >> 8); }
+	void dword(u32 value) { word(value); word(value >> 16); }
+	void opcode(u32 op) { if (op > 0xFF) byte(op >> 8); byte(op); }
+
+	void prefix(int size, int reg, int index, int base, int byte_regs) {
+		if (size == 2) byte(0x66);
+		u8 rex = (size == 8 ? 8 : 0) | (reg & 8 ? 4 : 0) | (index >= 0 && (index & 8) ? 2 : 0) | (base & 8 ? 1 : 0);
+		bool byte_reg = ((byte_regs & X86_BYTE_REG) && reg >= X86_RSP && reg <= X86_RDI)
+		             || ((byte_regs & X86_BYTE_RM) && base >= X86_RSP && base <= X86_RDI);
+		if (rex || byte_reg) byte(0x40 | rex);
+	}
+	void rr(int size, u32 op, int reg, int rm, int byte_regs) {
+		prefix(size, reg, -1, rm, byte_regs);
+		opcode(op);
+		byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+	}
+	void rm(int size, u32 op, int reg, int base, int index, int scale, s32 disp, int byte_regs) {
+		prefix(size, reg, index, base, byte_regs);
+		opcode(op);
+		if (index < 0 && (base & 7) != X86_RSP) {
+			byte(0x80 | (reg & 7) << 3 | (base & 7));
+		} else {
+			byte(0x84 | (reg & 7) << 3);
+			byte(scale << 6 | (index < 0 ? X86_RSP : index & 7) << 3 | (base & 7));
+		}
+		dword(disp);
+	}
+
+	// registers (32 bit unless noted)
+	void mov(int dst, int src) { rr(4, 0x89, src, dst, 0); }
+	void mov64(int dst, int src) { rr(8, 0x89, src, dst, 0); }
+	void mov8(int dst, int src) { rr(1, 0x88, src, dst, X86_BYTE_REG | X86_BYTE_RM); }
+	void movImm(int dst, u32 imm) { prefix(4, 0, -1, dst, 0); byte(0xB8 | (dst & 7)); dword(imm); }
+	void movImm64(int dst, u64 imm) { prefix(8, 0, -1, dst, 0); byte(0xB8 | (dst & 7)); dword(imm); dword(imm >> 32); }
+	void movzx8(int dst, int src) { rr(4, 0x0FB6, dst, src, X86_BYTE_RM); }
+	void movzx16(int dst, int src) { rr(4, 0x0FB7, dst, src, 0); }
+	void alu(int op, int dst, int src) { rr(4, op << 3 | 1, src, dst, 0); }
+	void aluImm(int size, int op, int dst, s32 imm) {
+		if (imm == (s8)imm) {
+			rr(size, 0x83, op, dst, 0);
+			byte(imm);
+		} else {
+			rr(size, 0x81, op, dst, 0);
+			if (size == 2) word(imm); else dword(imm);
+		}
+	}
+	void test(int a, int b) { rr(4, 0x85, b, a, 0); }
+	void test64(int a, int b) { rr(8, 0x85, b, a, 0); }
+	void shift(int op, int dst, int count) { rr(4, 0xC1, op, dst, 0); byte(count); }
+	void inc16(int dst) { rr(2, 0xFF, 0, dst, 0); }
+	void dec16(int dst) { rr(2, 0xFF, 1, dst, 0); }
+	void lea(int dst, int base, s32 disp) { rm(4, 0x8D, dst, base, -1, 0, disp, 0); }
+	void setcc(int cond, int dst) { rr(4, 0x0F90 | cond, 0, dst, X86_BYTE_RM); }
+	void push(int reg) { if (reg & 8) byte(0x41); byte(0x50 | (reg & 7)); }
+	void pop(int reg) { if (reg & 8) byte(0x41); byte(0x58 | (reg & 7)); }
+	void call(const void *function) { movImm64(X86_RAX, (u64)function); rr(4, 0xFF, 2, X86_RAX, 0); }
+	void jmpReg(int reg) { rr(4, 0xFF, 4, reg, 0); }
+	void ret() { byte(0xC3); }
+
+	// memory
+	void load8(int dst, int base, int index, s32 disp) { rm(4, 0x0FB6, dst, base, index, 0, disp, 0); }
+	void load16(int dst, int base, s32 disp) { rm(4, 0x0FB7, dst, base, -1, 0, disp, 0); }
+	void load64(int dst, int base, int index, int scale, s32 disp) { rm(8, 0x8B, dst, base, index, scale, disp, 0); }
+	void store8(int base, int index, s32 disp, int src) { rm(1, 0x88, src, base, index, 0, disp, X86_BYTE_REG); }
+	void store16(int base, s32 disp, int src) { rm(2, 0x89, src, base, -1, 0, disp, 0); }
+	void storeImm8(int base, s32 disp, u8 imm) { rm(1, 0xC6, 0, base, -1, 0, disp, 0); byte(imm); }
+	void storeImm16(int base, s32 disp, u16 imm) { rm(2, 0xC7, 0, base, -1, 0, disp, 0); word(imm); }
+	void storeImm32(int base, s32 disp, u32 imm) { rm(4, 0xC7, 0, base, -1, 0, disp, 0); dword(imm); }
+	void aluMem8(int op, int base, s32 disp, u8 imm) { rm(1, 0x80, op, base, -1, 0, disp, 0); byte(imm); }
+	void aluMem64(int op, int base, s32 disp, s32 imm) {
+		if (imm == (s8)imm) {
+			rm(8, 0x83, op, base, -1, 0, disp, 0);
+			byte(imm);
+		} else {
+			rm(8, 0x81, op, base, -1, 0, disp, 0);
+			dword(imm);
+		}
+	}
+	void testMem8(int base, s32 disp, u8 imm) { rm(1, 0xF6, 0, base, -1, 0, disp, 0); byte(imm); }
+
+	// jumps
+	int newLabel() {
+		if (label_count == JIT_MAX_LABELS) {
+			overflow = true;
+			return 0;
+		}
+		return label_count++;
+	}
+	void bind(int label) {
+		label_sections[label] = section;
+		label_offsets[label] = sizes[section];
+	}
+	void rel32(int label, const u8 *target) {
+		if (fixup_count == JIT_MAX_FIXUPS) {
+			overflow = true;
+			return;
+		}
+		fixups[fixup_count++] = { section, sizes[section], label, target };
+		dword(0);
+	}
+	void jcc(int cond, int label) { byte(0x0F); byte(0x80 | cond); rel32(label, nullptr); }
+	void jmp(int label) { byte(0xE9); rel32(label, nullptr); }
+	void jmpTo(const u8 *target) { byte(0xE9); rel32(-1, target); }
+
+	int size() { return sizes[JIT_HOT] + sizes[JIT_COLD]; }
+
+	// places the cold code and resolves the jumps, false: doesn't fit
+	bool link() {
+		if (overflow || size() > JIT_MAX_BLOCK_SIZE) return false;
+		u8 *code[2] = { hot, hot + sizes[JIT_HOT] };
+		memcpy(code[JIT_COLD], cold, sizes[JIT_COLD]);
+		for (int i = 0; i < fixup_count; i++) {
+			const JitFixup &f = fixups[i];
+			const u8 *target = f.label < 0 ? f.target : code[label_sections[f.label]] + label_offsets[f.label];
+			u8 *at = code[f.section] + f.offset;
+			s64 rel = target - (at + 4);
+			if (rel != (s32)rel) return false;
+			s32 rel32 = rel;
+			memcpy(at, &rel32, 4);
+		}
+		return true;
+	}
+};
+
+// called by the compiled code, cycle_count lacks the pending cycles of the
+// ops before the current one. the helpers add them for the interpreter and
+// update the budget afterwards: a bank switch or a store to cached code
+// resets the block cache cursor, then the block has to stop after this op
+static void updateJitBudget(CPU *cpu, u64 cycle) {
+	GameBoy *gb = cpu->memory->gb;
+	u64 next = gb->scheduler.next;
+	if (!gb->block_cache.block || cpu->memory->watch_hit >= 0) {
+		gb->jit.budget = -1;
+	} else if (next == EVENT_NEVER) {
+		gb->jit.budget = INT64_MAX;
+	} else {
+		gb->jit.budget = (s64)(next - cycle);
+	}
+}
+
+static u32 jitRead(CPU *cpu, u32 address, u32 pending, u32 pc) {
+	cpu->cycle_count += pending;
+	cpu->PC = pc;
+	u8 value = cpu->cycleRead<true>(address);
+	cpu->cycle_count -= pending;
+	updateJitBudget(cpu, cpu->cycle_count);
+	return value;
+}
+
+static void jitWrite(CPU *cpu, u32 address, u32 value, u32 pending, u32 pc) {
+	cpu->cycle_count += pending;
+	cpu->PC = pc;
+	cpu->cycleWrite<true>(address, value);
+	cpu->cycle_count -= pending;
+	updateJitBudget(cpu, cpu->cycle_count);
+}
+
+// ops without native code, the registers are in the CPU
+static void jitExecute(CPU *cpu, const DecodedOp *op, u32 pending, u32 pc) {
+	cpu->cycle_count += pending;
+	cpu->PC = pc + 1;
+	cpu->bus = op->opcode;
+	cpu->immediate = op->operand;
+	(cpu->*CPU::threaded_ops[op->opcode])();
+	cpu->addFastCycles(op->opcode);
+	updateJitBudget(cpu, cpu->cycle_count);
+}
+
+static void jitSyncFlags(CPU *cpu) {
+	cpu->syncFlags();
+}
+
+static const int jit_pair_regs[4] = { X86_RBP, X86_R12, X86_R13, X86_R14 }; // BC DE HL SP
+
+struct JitCompiler {
+	JitAssembler a;
+	CPU *cpu;
+	Jit *jit;
+	bool hram_watched; // HRAM accesses go through Memory
+
+	// offsets from the CPU in rbx
+	s32 d_A, d_F, d_BC, d_DE, d_HL, d_SP, d_PC, d_IME;
+	s32 d_lazy_op, d_lazy_a, d_lazy_b, d_lazy_res;
+	s32 d_cycle_count, d_budget;
+	s32 d_block_index, d_next_pc;
+	s32 d_read_pages, d_write_pages, d_hram, d_idle_dirty;
+
+	// state at the current op
+	int flags = -1; // LazyOp in effect, -1: unknown
+	u32 pending = 0; // cycles of the ops before, not added to cycle_count yet
+	u16 pc_next; // PC after the op
+
+	bool offset(s32 *d, const void *field) {
+		s64 offset = (const u8*)field - (const u8*)cpu;
+		*d = offset;
+		return offset > -(1<<30) && offset < (1<<30); // leaves room for the index
+	}
+
+	bool init(CPU *cpu) {
+		this->cpu = cpu;
+		Memory *memory = cpu->memory;
+		jit = &memory->gb->jit;
+		BlockCache *block_cache = &memory->gb->block_cache;
+		hram_watched = memory->watched_pages[ADR_HRAM >> PAGE_SHIFT];
+		return offset(&d_A, &cpu->A) && offset(&d_F, &cpu->F)
+		    && offset(&d_BC, &cpu->BC) && offset(&d_DE, &cpu->DE)
+		    && offset(&d_HL, &cpu->HL) && offset(&d_SP, &cpu->SP)
+		    && offset(&d_PC, &cpu->PC) && offset(&d_IME, &cpu->IME)
+		    && offset(&d_lazy_op, &cpu->lazy_op) && offset(&d_lazy_a, &cpu->lazy_a)
+		    && offset(&d_lazy_b, &cpu->lazy_b) && offset(&d_lazy_res, &cpu->lazy_res)
+		    && offset(&d_cycle_count, &cpu->cycle_count) && offset(&d_budget, &jit->budget)
+		    && offset(&d_block_index, &block_cache->block_index)
+		    && offset(&d_next_pc, &block_cache->next_pc)
+		    && offset(&d_read_pages, memory->read_pages) && offset(&d_write_pages, memory->write_pages)
+		    && offset(&d_hram, memory->hram) && offset(&d_idle_dirty, &memory->gb->idle_loop.dirty);
+	}
+
+	// guest registers
+
+	void loadRegisters() {
+		a.load16(X86_RBP, X86_RBX, d_BC);
+		a.load16(X86_R12, X86_RBX, d_DE);
+		a.load16(X86_R13, X86_RBX, d_HL);
+		a.load16(X86_R14, X86_RBX, d_SP);
+		a.load8(X86_R15, X86_RBX, -1, d_A);
+	}
+
+	void storeRegisters() {
+		a.store16(X86_RBX, d_BC, X86_RBP);
+		a.store16(X86_RBX, d_DE, X86_R12);
+		a.store16(X86_RBX, d_HL, X86_R13);
+		a.store16(X86_RBX, d_SP, X86_R14);
+		a.store8(X86_RBX, -1, d_A, X86_R15);
+	}
+
+	// r: B C D E H L - A as in the opcodes
+	void loadReg(int dst, int r) {
+		if (r == 7) {
+			a.mov(dst, X86_R15);
+			return;
+		}
+		int pair = jit_pair_regs[r >> 1];
+		if (r & 1) {
+			a.movzx8(dst, pair);
+		} else {
+			a.mov(dst, pair);
+			a.shift(X86_SHR, dst, 8);
+		}
+	}
+
+	// src holds a zero-extended byte and is clobbered
+	void storeReg(int r, int src) {
+		if (r == 7) {
+			a.mov(X86_R15, src);
+			return;
+		}
+		int pair = jit_pair_regs[r >> 1];
+		if (r & 1) {
+			a.mov8(pair, src);
+		} else {
+			a.shift(X86_SHL, src, 8);
+			a.movzx8(pair, pair);
+			a.alu(X86_OR, pair, src);
+		}
+	}
+
+	// memory, see CPU::cycleRead<true> and cycleWrite<true>
+
+	void callRead() { // address in eax
+		a.mov(X86_RSI, X86_RAX);
+		a.movImm(X86_RDX, pending);
+		a.movImm(X86_RCX, pc_next);
+		a.mov64(X86_RDI, X86_RBX);
+		a.call((const void*)jitRead);
+	}
+
+	void callWrite() { // address in eax, value in ecx
+		a.mov(X86_RSI, X86_RAX);
+		a.mov(X86_RDX, X86_RCX);
+		a.movImm(X86_RCX, pending);
+		a.movImm(X86_R8, pc_next);
+		a.mov64(X86_RDI, X86_RBX);
+		a.call((const void*)jitWrite);
+	}
+
+	// the byte at address (-1: in eax) to eax
+	void read(int address) {
+		int slow = a.newLabel(), done = a.newLabel();
+		if (address >= 0) {
+			if (address >= ADR_HRAM && address < ADR_IE && !hram_watched) {
+				a.load8(X86_RAX, X86_RBX, -1, d_hram + address - ADR_HRAM);
+			} else if (needsSync(address) || address >= ADR_OAM) {
+				a.movImm(X86_RAX, address);
+				callRead();
+			} else {
+				a.load64(X86_RDX, X86_RBX, -1, 0, d_read_pages + (address >> PAGE_SHIFT) * 8);
+				a.test64(X86_RDX, X86_RDX);
+				a.jcc(X86_E, slow);
+				a.load8(X86_RAX, X86_RDX, -1, address & (PAGE_SIZE-1));
+				a.bind(done);
+				a.section = JIT_COLD;
+				a.bind(slow);
+				a.movImm(X86_RAX, address);
+				callRead();
+				a.jmp(done);
+				a.section = JIT_HOT;
+			}
+			return;
+		}
+		int high = a.newLabel();
+		a.lea(X86_RCX, X86_RAX, -ADR_VRAM);
+		a.aluImm(4, X86_CMP, X86_RCX, SIZE_VRAM);
+		a.jcc(X86_B, slow);
+		a.aluImm(4, X86_CMP, X86_RAX, ADR_OAM);
+		a.jcc(X86_AE, high);
+		a.mov(X86_RCX, X86_RAX);
+		a.shift(X86_SHR, X86_RCX, PAGE_SHIFT);
+		a.load64(X86_RDX, X86_RBX, X86_RCX, 3, d_read_pages);
+		a.test64(X86_RDX, X86_RDX);
+		a.jcc(X86_E, slow);
+		a.movzx8(X86_RAX, X86_RAX);
+		a.load8(X86_RAX, X86_RDX, X86_RAX, 0);
+		a.bind(done);
+
+		a.section = JIT_COLD;
+		a.bind(high);
+		if (!hram_watched) {
+			a.aluImm(4, X86_CMP, X86_RAX, ADR_HRAM);
+			a.jcc(X86_B, slow);
+			a.aluImm(4, X86_CMP, X86_RAX, ADR_IE);
+			a.jcc(X86_E, slow);
+			a.load8(X86_RAX, X86_RBX, X86_RAX, d_hram - ADR_HRAM);
+			a.jmp(done);
+		}
+		a.bind(slow);
+		callRead();
+		a.jmp(done);
+		a.section = JIT_HOT;
+	}
+
+	// ecx to the byte at address (-1: in eax)
+	void write(int address) {
+		int slow = a.newLabel(), done = a.newLabel();
+		if (address >= 0) {
+			if (address >= ADR_HRAM && address < ADR_IE && !hram_watched) {
+				a.store8(X86_RBX, -1, d_hram + address - ADR_HRAM, X86_RCX);
+				a.storeImm8(X86_RBX, d_idle_dirty, 1);
+			} else if (needsSync(address) || address >= ADR_OAM || address < ADR_VRAM) {
+				a.movImm(X86_RAX, address); // MBC, IO or PPU
+				callWrite();
+			} else {
+				a.load64(X86_RDX, X86_RBX, -1, 0, d_write_pages + (address >> PAGE_SHIFT) * 8);
+				a.test64(X86_RDX, X86_RDX);
+				a.jcc(X86_E, slow);
+				a.store8(X86_RDX, -1, address & (PAGE_SIZE-1), X86_RCX);
+				a.storeImm8(X86_RBX, d_idle_dirty, 1);
+				a.bind(done);
+				a.section = JIT_COLD;
+				a.bind(slow);
+				a.movImm(X86_RAX, address);
+				callWrite();
+				a.jmp(done);
+				a.section = JIT_HOT;
+			}
+			return;
+		}
+		int high = a.newLabel();
+		a.lea(X86_RDX, X86_RAX, -ADR_VRAM);
+		a.aluImm(4, X86_CMP, X86_RDX, SIZE_VRAM);
+		a.jcc(X86_B, slow);
+		a.aluImm(4, X86_CMP, X86_RAX, ADR_OAM);
+		a.jcc(X86_AE, high);
+		a.mov(X86_RDX, X86_RAX);
+		a.shift(X86_SHR, X86_RDX, PAGE_SHIFT);
+		a.load64(X86_RDX, X86_RBX, X86_RDX, 3, d_write_pages);
+		a.test64(X86_RDX, X86_RDX);
+		a.jcc(X86_E, slow);
+		a.movzx8(X86_RAX, X86_RAX);
+		a.store8(X86_RDX, X86_RAX, 0, X86_RCX);
+		a.storeImm8(X86_RBX, d_idle_dirty, 1);
+		a.bind(done);
+
+		a.section = JIT_COLD;
+		a.bind(high);
+		if (!hram_watched) {
+			a.aluImm(4, X86_CMP, X86_RAX, ADR_HRAM);
+			a.jcc(X86_B, slow);
+			a.aluImm(4, X86_CMP, X86_RAX, ADR_IE);
+			a.jcc(X86_E, slow);
+			a.store8(X86_RBX, X86_RAX, d_hram - ADR_HRAM, X86_RCX);
+			a.storeImm8(X86_RBX, d_idle_dirty, 1);
+			a.jmp(done);
+		}
+		a.bind(slow);
+		callWrite();
+		a.jmp(done);
+		a.section = JIT_HOT;
+	}
+
+	// flags, FLAG_Z or FLAG_C
+
+	static const int FLAG_Z = 0x80;
+	static const int FLAG_C = 0x10;
+
+	void setLazyOp(int op) {
+		if (flags != op) a.storeImm8(X86_RBX, d_lazy_op, op);
+		flags = op;
+	}
+
+	// condition code that is true if the flag is set, clobbers scratch
+	int testFlag(int flag, int scratch) {
+		if (flags == LAZY_NONE) {
+			a.testMem8(X86_RBX, d_F, flag);
+			return X86_NE;
+		}
+		if (flags > LAZY_NONE) {
+			if (flag == FLAG_Z) {
+				a.testMem8(X86_RBX, d_lazy_res, 0xFF);
+				return X86_E;
+			}
+			a.testMem8(X86_RBX, d_lazy_res + 1, 0x01);
+			return X86_NE;
+		}
+		// see CPU::flagZ and flagC
+		int done = a.newLabel();
+		a.load8(scratch, X86_RBX, -1, d_F);
+		a.aluImm(4, X86_AND, scratch, flag);
+		a.aluMem8(X86_CMP, X86_RBX, d_lazy_op, LAZY_NONE);
+		a.jcc(X86_E, done);
+		if (flag == FLAG_Z) {
+			a.load8(scratch, X86_RBX, -1, d_lazy_res);
+			a.test(scratch, scratch);
+			a.setcc(X86_E, scratch);
+		} else {
+			a.load8(scratch, X86_RBX, -1, d_lazy_res + 1);
+			a.aluImm(4, X86_AND, scratch, 1);
+		}
+		a.bind(done);
+		a.test(scratch, scratch);
+		return X86_NE;
+	}
+
+	void flagValue(int flag, int dst) { // 0 or 1
+		int cond = testFlag(flag, dst);
+		a.setcc(cond, dst);
+		a.movzx8(dst, dst);
+	}
+
+	void syncFlags() {
+		if (flags == LAZY_NONE) return;
+		a.mov64(X86_RDI, X86_RBX);
+		a.call((const void*)jitSyncFlags);
+		flags = LAZY_NONE;
+	}
+
+	// ALU op with the operand in ecx, see SWITCH_ADD and the others
+	void alu(int kind) {
+		switch (kind) {
+		case 4: // AND
+			a.alu(X86_AND, X86_R15, X86_RCX);
+			a.store16(X86_RBX, d_lazy_res, X86_R15);
+			setLazyOp(LAZY_AND);
+			return;
+		case 5: // XOR
+		case 6: // OR
+			a.alu(kind == 5 ? X86_XOR : X86_OR, X86_R15, X86_RCX);
+			a.store16(X86_RBX, d_lazy_res, X86_R15);
+			setLazyOp(LAZY_OR);
+			return;
+		}
+		bool carry = kind == 1 || kind == 3; // ADC SBC
+		if (carry) flagValue(FLAG_C, X86_RDX);
+		a.mov(X86_RAX, X86_R15);
+		a.store8(X86_RBX, -1, d_lazy_a, X86_RAX);
+		a.store8(X86_RBX, -1, d_lazy_b, X86_RCX);
+		int op = kind <= 1 ? X86_ADD : X86_SUB;
+		a.alu(op, X86_RAX, X86_RCX);
+		if (carry) a.alu(op, X86_RAX, X86_RDX);
+		a.store16(X86_RBX, d_lazy_res, X86_RAX);
+		if (kind != 7) a.movzx8(X86_R15, X86_RAX); // CP only compares
+		setLazyOp(kind <= 1 ? LAZY_ADD : LAZY_SUB);
+	}
+
+	// leaving the block
+
+	void leave(u16 pc, bool static_pc, u32 cycles, int next_index) {
+		if (cycles) a.aluMem64(X86_ADD, X86_RBX, d_cycle_count, cycles);
+		if (static_pc) {
+			a.storeImm16(X86_RBX, d_PC, pc);
+			a.storeImm16(X86_RBX, d_next_pc, pc);
+		}
+		a.storeImm32(X86_RBX, d_block_index, next_index);
+		a.jmpTo(jit->leave);
+	}
+
+	// conditional exits, taken: the condition holds
+	void branch(int cond, u16 target, u32 cycles_taken, u32 cycles, int op_count) {
+		int taken = a.newLabel();
+		a.jcc(cond, taken);
+		leave(pc_next, true, pending + cycles, op_count);
+		a.bind(taken);
+		leave(target, true, pending + cycles_taken, op_count);
+	}
+
+	// pushes the return address
+	void pushPC() {
+		a.mov(X86_RAX, X86_R14);
+		a.aluImm(2, X86_SUB, X86_RAX, 1);
+		a.movImm(X86_RCX, pc_next >> 8);
+		write(-1);
+		a.mov(X86_RAX, X86_R14);
+		a.aluImm(2, X86_SUB, X86_RAX, 2);
+		a.movImm(X86_RCX, pc_next & 0xFF);
+		write(-1);
+		a.aluImm(2, X86_SUB, X86_R14, 2);
+	}
+
+	// pops into PC, the low byte waits in the stack slot of enter (the
+	// helpers set PC)
+	void popPC() {
+		a.mov(X86_RAX, X86_R14);
+		read(-1);
+		a.store8(X86_RSP, -1, 0, X86_RAX);
+		a.mov(X86_RAX, X86_R14);
+		a.aluImm(2, X86_ADD, X86_RAX, 1);
+		read(-1);
+		a.shift(X86_SHL, X86_RAX, 8);
+		a.load8(X86_RCX, X86_RSP, -1, 0);
+		a.alu(X86_OR, X86_RAX, X86_RCX);
+		a.store16(X86_RBX, d_PC, X86_RAX);
+		a.aluImm(2, X86_ADD, X86_R14, 2);
+	}
+
+	// the op through the threaded code, the registers go through the CPU
+	void fallback(const DecodedOp *op, u16 pc) {
+		storeRegisters();
+		a.mov64(X86_RDI, X86_RBX);
+		a.movImm64(X86_RSI, (u64)op);
+		a.movImm(X86_RDX, pending);
+		a.movImm(X86_RCX, pc);
+		a.call((const void*)jitExecute);
+		loadRegisters();
+		pending = 0;
+		flags = -1;
+	}
+
+	// a CB op, see CPU::stepPrefixCB
+	void prefixCB(u8 opcode) {
+		int reg = opcode & 7;
+		if (reg == 6) {
+			pending += (opcode>>6) == 1 ? 4 : 8; // before the access, like stepPrefixCB
+			a.mov(X86_RAX, X86_R13);
+			read(-1);
+		} else {
+			loadReg(X86_RAX, reg);
+		}
+		int bit = 1 << ((opcode>>3)&7);
+		switch (opcode>>6) {
+		case 0: // rotates and shifts, the result with the carry in bit 8
+			switch ((opcode>>3)&7) {
+			case 0: // RLC
+				a.mov(X86_RCX, X86_RAX);
+				a.shift(X86_SHR, X86_RCX, 7);
+				a.shift(X86_SHL, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				break;
+			case 1: // RRC
+				a.mov(X86_RCX, X86_RAX);
+				a.aluImm(4, X86_AND, X86_RCX, 1);
+				a.mov(X86_RDX, X86_RCX);
+				a.shift(X86_SHL, X86_RCX, 7);
+				a.shift(X86_SHL, X86_RDX, 8);
+				a.shift(X86_SHR, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				a.alu(X86_OR, X86_RAX, X86_RDX);
+				break;
+			case 2: // RL
+				flagValue(FLAG_C, X86_RDX);
+				a.shift(X86_SHL, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RDX);
+				break;
+			case 3: // RR
+				flagValue(FLAG_C, X86_RDX);
+				a.mov(X86_RCX, X86_RAX);
+				a.aluImm(4, X86_AND, X86_RCX, 1);
+				a.shift(X86_SHL, X86_RCX, 8);
+				a.shift(X86_SHL, X86_RDX, 7);
+				a.shift(X86_SHR, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RDX);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				break;
+			case 4: // SLA
+				a.shift(X86_SHL, X86_RAX, 1);
+				break;
+			case 5: // SRA
+				a.mov(X86_RCX, X86_RAX);
+				a.aluImm(4, X86_AND, X86_RCX, 1);
+				a.shift(X86_SHL, X86_RCX, 8);
+				a.mov(X86_RDX, X86_RAX);
+				a.aluImm(4, X86_AND, X86_RDX, 0x80);
+				a.shift(X86_SHR, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RDX);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				break;
+			case 6: // SWAP
+				a.mov(X86_RCX, X86_RAX);
+				a.shift(X86_SHR, X86_RCX, 4);
+				a.shift(X86_SHL, X86_RAX, 4);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				a.aluImm(4, X86_AND, X86_RAX, 0xFF);
+				break;
+			case 7: // SRL
+				a.mov(X86_RCX, X86_RAX);
+				a.aluImm(4, X86_AND, X86_RCX, 1);
+				a.shift(X86_SHL, X86_RCX, 8);
+				a.shift(X86_SHR, X86_RAX, 1);
+				a.alu(X86_OR, X86_RAX, X86_RCX);
+				break;
+			}
+			a.store16(X86_RBX, d_lazy_res, X86_RAX);
+			setLazyOp(LAZY_OR);
+			a.movzx8(X86_RAX, X86_RAX);
+			break;
+		case 1: // BIT (carry is kept)
+			flagValue(FLAG_C, X86_RDX);
+			a.aluImm(4, X86_AND, X86_RAX, bit);
+			a.shift(X86_SHL, X86_RDX, 8);
+			a.alu(X86_OR, X86_RAX, X86_RDX);
+			a.store16(X86_RBX, d_lazy_res, X86_RAX);
+			setLazyOp(LAZY_AND);
+			return;
+		case 2: // RES
+			a.aluImm(4, X86_AND, X86_RAX, ~bit & 0xFF);
+			break;
+		case 3: // SET
+			a.aluImm(4, X86_OR, X86_RAX, bit);
+			break;
+		}
+		if (reg == 6) {
+			a.mov(X86_RCX, X86_RAX);
+			a.mov(X86_RAX, X86_R13);
+			write(-1);
+			return;
+		}
+		storeReg(reg, X86_RAX);
+	}
+
+	// the code of the op, false: it leaves the block (on every path)
+	bool compileOp(Block *block, int index, u16 pc) {
+		const DecodedOp *op = &block->ops[index];
+		u8 opcode = op->opcode;
+		u8 d8 = op->operand[0];
+		u16 d16 = op->operand[0] | op->operand[1] << 8;
+		const InstructionInfo &info = CPU::instruction_infos[opcode];
+		u32 cycles = info.cycles;
+		int op_count = block->op_count;
+		pc_next = pc + op->length;
+
+		if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) { // LD r,r
+			int dst = (opcode>>3)&7, src = opcode&7;
+			if (src == 6) {
+				a.mov(X86_RAX, X86_R13);
+				read(-1);
+				storeReg(dst, X86_RAX);
+			} else if (dst == 6) {
+				loadReg(X86_RCX, src);
+				a.mov(X86_RAX, X86_R13);
+				write(-1);
+			} else if (dst != src) {
+				loadReg(X86_RAX, src);
+				storeReg(dst, X86_RAX);
+			}
+			pending += cycles;
+			return true;
+		}
+		if (opcode >= 0x80 && opcode < 0xC0) { // ALU A,r
+			int src = opcode&7;
+			if (src == 6) {
+				a.mov(X86_RAX, X86_R13);
+				read(-1);
+				a.mov(X86_RCX, X86_RAX);
+			} else {
+				loadReg(X86_RCX, src);
+			}
+			alu((opcode>>3)&7);
+			pending += cycles;
+			return true;
+		}
+
+		int pair = jit_pair_regs[(opcode>>4)&3];
+		int reg = (opcode>>3)&7;
+		switch (opcode) {
+		case 0x00: break; // NOP
+
+		case 0x01: case 0x11: case 0x21: case 0x31: // LD rr,d16
+			a.movImm(pair, d16);
+			break;
+		case 0x03: case 0x13: case 0x23: case 0x33: a.inc16(pair); break; // INC rr
+		case 0x0B: case 0x1B: case 0x2B: case 0x3B: a.dec16(pair); break; // DEC rr
+
+		case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x34: case 0x3C: // INC r
+		case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x35: case 0x3D: // DEC r
+		{
+			// see SWITCH_INC and SWITCH_DEC
+			bool inc = !(opcode & 1);
+			if (reg == 6) {
+				a.mov(X86_RAX, X86_R13);
+				read(-1);
+			} else {
+				loadReg(X86_RAX, reg);
+			}
+			flagValue(FLAG_C, X86_RDX);
+			a.store8(X86_RBX, -1, d_lazy_a, X86_RAX);
+			a.storeImm8(X86_RBX, d_lazy_b, 1);
+			a.aluImm(4, inc ? X86_ADD : X86_SUB, X86_RAX, 1);
+			a.movzx8(X86_RAX, X86_RAX);
+			a.shift(X86_SHL, X86_RDX, 8);
+			a.alu(X86_OR, X86_RDX, X86_RAX);
+			a.store16(X86_RBX, d_lazy_res, X86_RDX);
+			setLazyOp(inc ? LAZY_ADD : LAZY_SUB);
+			if (reg == 6) {
+				a.mov(X86_RCX, X86_RAX);
+				a.mov(X86_RAX, X86_R13);
+				write(-1);
+			} else {
+				storeReg(reg, X86_RAX);
+			}
+		} break;
+
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: // LD r,d8
+			a.movImm(X86_RAX, d8);
+			storeReg(reg, X86_RAX);
+			break;
+		case 0x36: // LD (HL),d8
+			a.movImm(X86_RCX, d8);
+			a.mov(X86_RAX, X86_R13);
+			write(-1);
+			break;
+
+		case 0x02: case 0x12: // LD (BC),A LD (DE),A
+			a.mov(X86_RAX, pair);
+			a.mov(X86_RCX, X86_R15);
+			write(-1);
+			break;
+		case 0x0A: case 0x1A: // LD A,(BC) LD A,(DE)
+			a.mov(X86_RAX, pair);
+			read(-1);
+			a.mov(X86_R15, X86_RAX);
+			break;
+		case 0x22: case 0x32: // LD (HL+),A LD (HL-),A
+			a.mov(X86_RAX, X86_R13);
+			a.mov(X86_RCX, X86_R15);
+			write(-1);
+			if (opcode == 0x22) a.inc16(X86_R13); else a.dec16(X86_R13);
+			break;
+		case 0x2A: case 0x3A: // LD A,(HL+) LD A,(HL-)
+			a.mov(X86_RAX, X86_R13);
+			read(-1);
+			a.mov(X86_R15, X86_RAX);
+			if (opcode == 0x2A) a.inc16(X86_R13); else a.dec16(X86_R13);
+			break;
+
+		case 0x07: // RLCA
+			a.mov(X86_RAX, X86_R15);
+			a.mov(X86_RCX, X86_RAX);
+			a.shift(X86_SHR, X86_RCX, 7);
+			a.shift(X86_SHL, X86_RAX, 1);
+			a.alu(X86_OR, X86_RAX, X86_RCX);
+			a.movzx8(X86_R15, X86_RAX);
+			a.shift(X86_SHL, X86_RCX, 4);
+			a.store8(X86_RBX, -1, d_F, X86_RCX);
+			setLazyOp(LAZY_NONE);
+			break;
+		case 0x0F: // RRCA
+			a.mov(X86_RAX, X86_R15);
+			a.mov(X86_RCX, X86_RAX);
+			a.aluImm(4, X86_AND, X86_RCX, 1);
+			a.mov(X86_RDX, X86_RCX);
+			a.shift(X86_SHL, X86_RDX, 7);
+			a.shift(X86_SHR, X86_RAX, 1);
+			a.alu(X86_OR, X86_RAX, X86_RDX);
+			a.mov(X86_R15, X86_RAX);
+			a.shift(X86_SHL, X86_RCX, 4);
+			a.store8(X86_RBX, -1, d_F, X86_RCX);
+			setLazyOp(LAZY_NONE);
+			break;
+		case 0x17: // RLA
+			flagValue(FLAG_C, X86_RDX);
+			a.mov(X86_RAX, X86_R15);
+			a.shift(X86_SHL, X86_RAX, 1);
+			a.alu(X86_OR, X86_RAX, X86_RDX);
+			a.mov(X86_RCX, X86_RAX);
+			a.shift(X86_SHR, X86_RCX, 8);
+			a.shift(X86_SHL, X86_RCX, 4);
+			a.movzx8(X86_R15, X86_RAX);
+			a.store8(X86_RBX, -1, d_F, X86_RCX);
+			setLazyOp(LAZY_NONE);
+			break;
+		case 0x1F: // RRA
+			flagValue(FLAG_C, X86_RDX);
+			a.mov(X86_RAX, X86_R15);
+			a.mov(X86_RCX, X86_RAX);
+			a.aluImm(4, X86_AND, X86_RCX, 1);
+			a.shift(X86_SHR, X86_RAX, 1);
+			a.shift(X86_SHL, X86_RDX, 7);
+			a.alu(X86_OR, X86_RAX, X86_RDX);
+			a.mov(X86_R15, X86_RAX);
+			a.shift(X86_SHL, X86_RCX, 4);
+			a.store8(X86_RBX, -1, d_F, X86_RCX);
+			setLazyOp(LAZY_NONE);
+			break;
+
+		case 0x08: // LD (a16),SP
+			a.movzx8(X86_RCX, X86_R14);
+			write(d16);
+			a.mov(X86_RCX, X86_R14);
+			a.shift(X86_SHR, X86_RCX, 8);
+			write((u16)(d16 + 1));
+			break;
+
+		case 0x09: case 0x19: case 0x29: case 0x39: // ADD HL,rr
+		{
+			// see SWITCH_ADD_HL, only Z is kept
+			flagValue(FLAG_Z, X86_RSI);
+			a.mov(X86_RAX, X86_R13);
+			a.mov(X86_RCX, pair);
+			a.mov(X86_RDX, X86_RAX);
+			a.aluImm(4, X86_AND, X86_RDX, 0xFFF);
+			a.mov(X86_RDI, X86_RCX);
+			a.aluImm(4, X86_AND, X86_RDI, 0xFFF);
+			a.alu(X86_ADD, X86_RDX, X86_RDI);
+			a.shift(X86_SHR, X86_RDX, 12);
+			a.shift(X86_SHL, X86_RDX, 5); // H
+			a.alu(X86_ADD, X86_RAX, X86_RCX);
+			a.mov(X86_RCX, X86_RAX);
+			a.shift(X86_SHR, X86_RCX, 16);
+			a.shift(X86_SHL, X86_RCX, 4); // C
+			a.alu(X86_OR, X86_RDX, X86_RCX);
+			a.shift(X86_SHL, X86_RSI, 7); // Z
+			a.alu(X86_OR, X86_RDX, X86_RSI);
+			a.load8(X86_RCX, X86_RBX, -1, d_F);
+			a.aluImm(4, X86_AND, X86_RCX, 0x0F);
+			a.alu(X86_OR, X86_RDX, X86_RCX);
+			a.store8(X86_RBX, -1, d_F, X86_RDX);
+			a.movzx16(X86_R13, X86_RAX);
+			setLazyOp(LAZY_NONE);
+		} break;
+
+		case 0x2F: // CPL
+			a.aluImm(4, X86_XOR, X86_R15, 0xFF);
+			syncFlags();
+			a.aluMem8(X86_OR, X86_RBX, d_F, 0x60);
+			break;
+		case 0x37: // SCF
+			syncFlags();
+			a.aluMem8(X86_AND, X86_RBX, d_F, 0x8F);
+			a.aluMem8(X86_OR, X86_RBX, d_F, 0x10);
+			break;
+		case 0x3F: // CCF
+			syncFlags();
+			a.aluMem8(X86_AND, X86_RBX, d_F, 0x9F);
+			a.aluMem8(X86_XOR, X86_RBX, d_F, 0x10);
+			break;
+
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: // ALU A,d8
+			a.movImm(X86_RCX, d8);
+			alu(reg);
+			break;
+
+		case 0xE0: // LDH (a8),A
+			a.mov(X86_RCX, X86_R15);
+			write(0xFF00 | d8);
+			break;
+		case 0xF0: // LDH A,(a8)
+			read(0xFF00 | d8);
+			a.mov(X86_R15, X86_RAX);
+			break;
+		case 0xE2: // LD (C),A
+			a.movzx8(X86_RAX, X86_RBP);
+			a.aluImm(4, X86_OR, X86_RAX, 0xFF00);
+			a.mov(X86_RCX, X86_R15);
+			write(-1);
+			break;
+		case 0xF2: // LD A,(C)
+			a.movzx8(X86_RAX, X86_RBP);
+			a.aluImm(4, X86_OR, X86_RAX, 0xFF00);
+			read(-1);
+			a.mov(X86_R15, X86_RAX);
+			break;
+		case 0xEA: // LD (a16),A
+			a.mov(X86_RCX, X86_R15);
+			write(d16);
+			break;
+		case 0xFA: // LD A,(a16)
+			read(d16);
+			a.mov(X86_R15, X86_RAX);
+			break;
+		case 0xF9: a.mov(X86_R14, X86_R13); break; // LD SP,HL
+
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5: // PUSH
+		{
+			int hi = (opcode>>4)&3;
+			if (opcode == 0xF5) syncFlags();
+			a.mov(X86_RAX, X86_R14);
+			a.aluImm(2, X86_SUB, X86_RAX, 1);
+			if (opcode == 0xF5) a.mov(X86_RCX, X86_R15); else loadReg(X86_RCX, hi*2);
+			write(-1);
+			a.mov(X86_RAX, X86_R14);
+			a.aluImm(2, X86_SUB, X86_RAX, 2);
+			if (opcode == 0xF5) a.load8(X86_RCX, X86_RBX, -1, d_F); else loadReg(X86_RCX, hi*2 + 1);
+			write(-1);
+			a.aluImm(2, X86_SUB, X86_R14, 2);
+		} break;
+		case 0xC1: case 0xD1: case 0xE1: case 0xF1: // POP
+		{
+			int hi = (opcode>>4)&3;
+			a.mov(X86_RAX, X86_R14);
+			read(-1);
+			if (opcode == 0xF1) {
+				a.aluImm(4, X86_AND, X86_RAX, 0xF0);
+				a.store8(X86_RBX, -1, d_F, X86_RAX);
+			} else {
+				storeReg(hi*2 + 1, X86_RAX);
+			}
+			a.mov(X86_RAX, X86_R14);
+			a.aluImm(2, X86_ADD, X86_RAX, 1);
+			read(-1);
+			storeReg(opcode == 0xF1 ? 7 : hi*2, X86_RAX);
+			a.aluImm(2, X86_ADD, X86_R14, 2);
+			if (opcode == 0xF1) setLazyOp(LAZY_NONE);
+		} break;
+
+		case 0xF3: a.storeImm8(X86_RBX, d_IME, 0); break; // DI
+		case 0xFB: a.storeImm8(X86_RBX, d_IME, 1); break; // EI
+
+		case 0xCB:
+			prefixCB(d8);
+			break;
+
+		// jumps end the block
+		case 0x18: // JR
+			leave(pc_next + (s8)d8, true, pending + cycles, op_count);
+			return false;
+		case 0x20: case 0x28: case 0x30: case 0x38: // JR cc
+		{
+			int cond = testFlag(opcode & 0x10 ? FLAG_C : FLAG_Z, X86_RDX);
+			if (!(opcode & 0x08)) cond ^= 1; // NZ NC
+			branch(cond, pc_next + (s8)d8, info.cycles_branch, cycles, op_count);
+		} return false;
+		case 0xC3: // JP
+			leave(d16, true, pending + cycles, op_count);
+			return false;
+		case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc
+		{
+			int cond = testFlag(opcode & 0x10 ? FLAG_C : FLAG_Z, X86_RDX);
+			if (!(opcode & 0x08)) cond ^= 1;
+			branch(cond, d16, info.cycles_branch, cycles, op_count);
+		} return false;
+		case 0xE9: // JP (HL)
+			a.store16(X86_RBX, d_PC, X86_R13);
+			leave(0, false, pending + cycles, op_count);
+			return false;
+		case 0xCD: // CALL
+			pushPC();
+			leave(d16, true, pending + cycles, op_count);
+			return false;
+		case 0xC4: case 0xCC: case 0xD4: case 0xDC: // CALL cc
+		{
+			int cond = testFlag(opcode & 0x10 ? FLAG_C : FLAG_Z, X86_RDX);
+			if (opcode & 0x08) cond ^= 1; // to not taken
+			int not_taken = a.newLabel();
+			a.jcc(cond, not_taken);
+			pushPC();
+			leave(d16, true, pending + info.cycles_branch, op_count);
+			a.bind(not_taken);
+			leave(pc_next, true, pending + cycles, op_count);
+		} return false;
+		case 0xC9: case 0xD9: // RET RETI
+			if (opcode == 0xD9) a.storeImm8(X86_RBX, d_IME, 1);
+			popPC();
+			leave(0, false, pending + cycles, op_count);
+			return false;
+		case 0xC0: case 0xC8: case 0xD0: case 0xD8: // RET cc
+		{
+			int cond = testFlag(opcode & 0x10 ? FLAG_C : FLAG_Z, X86_RDX);
+			if (opcode & 0x08) cond ^= 1;
+			int not_taken = a.newLabel();
+			a.jcc(cond, not_taken);
+			popPC();
+			leave(0, false, pending + info.cycles_branch, op_count);
+			a.bind(not_taken);
+			leave(pc_next, true, pending + cycles, op_count);
+		} return false;
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+			pushPC();
+			leave(opcode & 0x38, true, pending + cycles, op_count);
+			return false;
+
+		default: // DAA STOP HALT ADD SP,r8 LD HL,SP+r8
+			fallback(op, pc);
+			if (index == op_count - 1) {
+				leave(0, false, 0, op_count); // HALT and STOP end the block
+				return false;
+			}
+			return true;
+		}
+		pending += cycles;
+		return true;
+	}
+};
+
+Jit::~Jit() {
+	if (buffer) munmap(buffer, JIT_BUFFER_SIZE);
+}
+
+// enter(cpu, code) and leave at the start of the buffer, false: no
+// executable memory
+static bool initJit(CPU *cpu) {
+	Jit *jit = &cpu->memory->gb->jit;
+	void *buffer = mmap(nullptr, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+	                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		LOGW("no executable memory for the JIT, blocks stay threaded");
+		return false;
+	}
+	jit->buffer = (u8*)buffer;
+
+	JitCompiler *c = new JitCompiler();
+	JitAssembler *a = &c->a;
+	a->hot = jit->buffer;
+	bool ok = c->init(cpu);
+	// callee-saved registers, 8 more bytes align the stack for the calls
+	a->push(X86_RBX);
+	a->push(X86_RBP);
+	a->push(X86_R12);
+	a->push(X86_R13);
+	a->push(X86_R14);
+	a->push(X86_R15);
+	a->aluImm(8, X86_SUB, X86_RSP, 8);
+	a->mov64(X86_RBX, X86_RDI);
+	c->loadRegisters();
+	a->jmpReg(X86_RSI);
+	int leave = a->sizes[JIT_HOT];
+	c->storeRegisters();
+	a->aluImm(8, X86_ADD, X86_RSP, 8);
+	a->pop(X86_R15);
+	a->pop(X86_R14);
+	a->pop(X86_R13);
+	a->pop(X86_R12);
+	a->pop(X86_RBP);
+	a->pop(X86_RBX);
+	a->ret();
+	ok = ok && a->link();
+	jit->enter = (JitEnterFn)jit->buffer;
+	jit->leave = jit->buffer + leave;
+	jit->stubs_size = (a->size() + 15) & ~15;
+	jit->used = jit->stubs_size;
+	delete c;
+	return ok;
+}
+
+// the block's code, nullptr: it can't be compiled
+JitBlock *CPU::compileBlock(Block *block) {
+	Jit *jit = &memory->gb->jit;
+	if (!jit->buffer && !initJit(this)) {
+		jit->failed = true;
+		return nullptr;
+	}
+	if (jit->used + (int)sizeof(JitBlock) + JIT_MAX_BLOCK_SIZE > JIT_BUFFER_SIZE) flushJit();
+
+	JitBlock *jit_block = (JitBlock*)(jit->buffer + jit->used);
+	JitCompiler *c = new JitCompiler();
+	c->a.hot = (u8*)(jit_block + 1);
+	if (!c->init(this)) {
+		delete c;
+		jit->failed = true;
+		return nullptr;
+	}
+	u16 pc = block->key & 0xFFFF;
+	for (int i = 0; i < block->op_count; i++) {
+		jit_block->entries[i] = c->a.hot + c->a.sizes[JIT_HOT] - (u8*)jit_block;
+		jit_block->pending[i] = c->pending;
+		jit_block->flags[i] = c->flags;
+		bool more = c->compileOp(block, i, pc);
+		pc = c->pc_next;
+		if (!more) break;
+		if (i == block->op_count - 1) {
+			c->leave(pc, true, c->pending, block->op_count); // op limit or region end
+		} else {
+			// IRQs might be due, see runBlock
+			int exit = c->a.newLabel();
+			c->a.aluMem64(X86_CMP, X86_RBX, c->d_budget, c->pending);
+			c->a.jcc(X86_L, exit);
+			c->a.section = JIT_COLD;
+			c->a.bind(exit);
+			c->leave(pc, true, c->pending, i + 1);
+			c->a.section = JIT_HOT;
+		}
+	}
+	bool linked = c->a.link();
+	int size = c->a.size();
+	delete c;
+	if (!linked) return nullptr;
+	jit->used += (sizeof(JitBlock) + size + 15) & ~15;
+	jit->DEBUG_compile_count++;
+	return jit_block;
+}
+
+// drops all blocks' code, the stubs stay
+void CPU::flushJit() {
+	BlockCache *block_cache = &memory->gb->block_cache;
+	Jit *jit = &memory->gb->jit;
+	if (block_cache->blocks) {
+		for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+			block_cache->blocks[i].jit = nullptr;
+			block_cache->blocks[i].runs = 0;
+		}
+	}
+	jit->used = jit->stubs_size;
+	jit->DEBUG_flush_count++;
+}
+
+bool CPU::runJit(Block *block, const DecodedOp *op) {
+	Jit *jit = &memory->gb->jit;
+	if (!block->jit) {
+		if (jit->failed || block->runs < 0 || ++block->runs < JIT_HOT_RUNS) return false;
+		block->jit = compileBlock(block);
+		if (!block->jit) {
+			block->runs = -1; // stays threaded
+			return false;
+		}
+	}
+	if (PC >= ADR_RAM_INTERNAL_MIRROR) return false; // the code has the PCs of WRAM
+	JitBlock *jit_block = block->jit;
+	int index = op - block->ops;
+	// the code after the first op assumes the flags state the ops before it left
+	if (jit_block->flags[index] >= 0 && jit_block->flags[index] != lazy_op) return false;
+	cycle_count -= jit_block->pending[index];
+	updateJitBudget(this, cycle_count);
+	jit->enter(this, (const u8*)jit_block + jit_block->entries[index]);
+	return true;
+}
+
+#else
+
+Jit::~Jit() {}
+
+#endif
@@ -0,0 +1,612 @@
+// switch dispatched interpreter
+// executes a whole instruction per call but keeps the M-cycle timing of
+// the micro-op state machine in cpu_instructions.h: every bus access
+// happens in the same M-cycle and sees the PPU and timers caught up to it
+// with FAST=true the bus accesses only catch up to the start of the
+// instruction, its cycles are taken from instruction_infos
+
+#ifdef _MSC_VER
+#define ALWAYS_INLINE __forceinline
+#else
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+// finishes the current M-cycle and begins the next one
+void CPU::cycleNext() {
+	cycle_count += 2;
+}
+
+template <bool FAST>
+u8 CPU::cycleRead(u16 adr) {
+	if (FAST) {
+		if (needsSync(adr)) {
+			memory->gb->catchUp();
+			memory->gb->idle_loop.onRead(adr);
+		}
+		return memory->load8(adr);
+	}
+	cycleNext();
+	u8 value = syncedLoad8(adr);
+	cycle_count += 2;
+	return value;
+}
+
+template <bool FAST>
+u8 CPU::cycleReadPC() {
+	if (FAST && immediate) {
+		PC++;
+		return *immediate++;
+	}
+	return cycleRead<FAST>(PC++);
+}
+
+template <bool FAST>
+void CPU::cycleWrite(u16 adr, u8 value) {
+	if (FAST) {
+		if (needsSync(adr)) memory->gb->catchUp();
+		memory->store8(adr, value);
+		memory->gb->idle_loop.onWrite();
+		if ((adr >= ADR_IO && adr < ADR_HRAM) || adr == ADR_IE) {
+			memory->gb->scheduler.schedule(EVENT_SYNC, cycle_count);
+		}
+		return;
+	}
+	cycleNext();
+	syncedStore8(adr, value);
+	cycle_count += 2;
+}
+
+template <bool FAST>
+void CPU::cycleIdle() {
+	if (FAST) return;
+	cycleNext();
+	cycle_count += 2;
+}
+
+u8 CPU::flagZ() {
+	return lazy_op ? !(lazy_res&0xFF) : F_Z;
+}
+
+u8 CPU::flagC() {
+	return lazy_op ? (lazy_res>>8)&1 : F_C;
+}
+
+void CPU::syncFlags() {
+	switch (lazy_op) {
+	case LAZY_NONE: return;
+	case LAZY_ADD:
+	case LAZY_SUB:
+		F_N = lazy_op == LAZY_SUB;
+		F_H = ((lazy_a ^ lazy_b ^ lazy_res) >> 4) & 1;
+		break;
+	case LAZY_AND: F_N = 0; F_H = 1; break;
+	case LAZY_OR:  F_N = 0; F_H = 0; break;
+	}
+	F_Z = !(lazy_res&0xFF);
+	F_C = (lazy_res>>8)&1;
+	lazy_op = LAZY_NONE;
+}
+
+// lazy flags: the ALU ops only store operands and result (bit 8: carry),
+// F is computed from them when it's read (see syncFlags)
+#define LAZY_FLAGS(OP, OPERAND_A, OPERAND_B, RES) \
+	lazy_a = OPERAND_A; lazy_b = OPERAND_B; lazy_res = RES; lazy_op = OP;
+
+// carry is kept
+#define SWITCH_INC(REG) { \
+	u16 res = ((REG + 1)&0xFF) | (flagC()<<8); \
+	LAZY_FLAGS(LAZY_ADD, REG, 1, res) \
+	REG = res; }
+
+#define SWITCH_DEC(REG) { \
+	u16 res = ((REG - 1)&0xFF) | (flagC()<<8); \
+	LAZY_FLAGS(LAZY_SUB, REG, 1, res) \
+	REG = res; }
+
+#define SWITCH_ADD(OPERAND) { \
+	u8 op = OPERAND; \
+	LAZY_FLAGS(LAZY_ADD, A, op, A + op) \
+	A = lazy_res; }
+
+#define SWITCH_ADC(OPERAND) { \
+	u8 op = OPERAND; \
+	LAZY_FLAGS(LAZY_ADD, A, op, A + op + flagC()) \
+	A = lazy_res; }
+
+#define SWITCH_SUB(OPERAND) { \
+	u8 op = OPERAND; \
+	LAZY_FLAGS(LAZY_SUB, A, op, A - op) \
+	A = lazy_res; }
+
+#define SWITCH_SBC(OPERAND) { \
+	u8 op = OPERAND; \
+	LAZY_FLAGS(LAZY_SUB, A, op, A - op - flagC()) \
+	A = lazy_res; }
+
+#define SWITCH_AND(OPERAND) { A &= OPERAND; lazy_res = A; lazy_op = LAZY_AND; }
+#define SWITCH_XOR(OPERAND) { A ^= OPERAND; lazy_res = A; lazy_op = LAZY_OR; }
+#define SWITCH_OR(OPERAND)  { A |= OPERAND; lazy_res = A; lazy_op = LAZY_OR; }
+
+#define SWITCH_CP(OPERAND) { \
+	u8 op = OPERAND; \
+	LAZY_FLAGS(LAZY_SUB, A, op, A - op) }
+
+// 16 bit addition in two M-cycles (low byte first), zero flag is kept
+#define SWITCH_ADD_HL(REG_HI, REG_LO) { \
+	syncFlags(); \
+	int res = L + REG_LO; \
+	L = res; \
+	F_C = res >= 0x100; \
+	cycleIdle<FAST>(); \
+	res = H + REG_HI + F_C; \
+	F_N = 0; \
+	F_H = (H&0xF) + (REG_HI&0xF) + F_C >= 0x10; \
+	F_C = res >= 0x100; \
+	H = res; }
+
+#define SWITCH_LD_D16(REG_HI, REG_LO) \
+	REG_LO = cycleReadPC<FAST>(); \
+	REG_HI = cycleReadPC<FAST>();
+
+#define SWITCH_PUSH(REG_HI, REG_LO) \
+	cycleWrite<FAST>(--SP, REG_HI); \
+	cycleWrite<FAST>(--SP, REG_LO); \
+	cycleIdle<FAST>();
+
+#define SWITCH_POP(REG_HI, REG_LO) \
+	REG_LO = cycleRead<FAST>(SP++); \
+	REG_HI = cycleRead<FAST>(SP++);
+
+#define SWITCH_JP(CONDITION) { \
+	condition = CONDITION; \
+	u16 target = cycleReadPC<FAST>(); \
+	target |= cycleReadPC<FAST>() << 8; \
+	if (condition) { \
+		PC = target; \
+		cycleIdle<FAST>(); \
+	} }
+
+#define SWITCH_JR(CONDITION) { \
+	condition = CONDITION; \
+	s8 offset = cycleReadPC<FAST>(); \
+	if (condition) { \
+		PC += offset; \
+		cycleIdle<FAST>(); \
+	} }
+
+#define SWITCH_CALL(CONDITION) { \
+	condition = CONDITION; \
+	u16 target = cycleReadPC<FAST>(); \
+	target |= cycleReadPC<FAST>() << 8; \
+	if (condition) { \
+		cycleIdle<FAST>(); \
+		cycleWrite<FAST>(--SP, PC >> 8); \
+		cycleWrite<FAST>(--SP, PC); \
+		PC = target; \
+	} }
+
+#define SWITCH_RET() { \
+	u16 target = cycleRead<FAST>(SP); \
+	target |= cycleRead<FAST>(SP+1) << 8; \
+	SP += 2; \
+	PC = target; \
+	cycleIdle<FAST>(); }
+
+#define SWITCH_RET_CONDITIONAL(CONDITION) { \
+	condition = CONDITION; \
+	cycleIdle<FAST>(); \
+	if (condition) SWITCH_RET() }
+
+#define SWITCH_RST(ADDRESS) \
+	cycleIdle<FAST>(); \
+	cycleWrite<FAST>(--SP, PC >> 8); \
+	cycleWrite<FAST>(--SP, PC); \
+	PC = ADDRESS;
+
+#define SWITCH_CASES_LD(OPCODE, REG) \
+	case OPCODE+0: REG = B; break; \
+	case OPCODE+1: REG = C; break; \
+	case OPCODE+2: REG = D; break; \
+	case OPCODE+3: REG = E; break; \
+	case OPCODE+4: REG = H; break; \
+	case OPCODE+5: REG = L; break; \
+	case OPCODE+6: REG = cycleRead<FAST>(HL); break; \
+	case OPCODE+7: REG = A; break;
+
+#define SWITCH_CASES_ALU(OPCODE, OP_NAME) \
+	case OPCODE+0: SWITCH_ ## OP_NAME(B) break; \
+	case OPCODE+1: SWITCH_ ## OP_NAME(C) break; \
+	case OPCODE+2: SWITCH_ ## OP_NAME(D) break; \
+	case OPCODE+3: SWITCH_ ## OP_NAME(E) break; \
+	case OPCODE+4: SWITCH_ ## OP_NAME(H) break; \
+	case OPCODE+5: SWITCH_ ## OP_NAME(L) break; \
+	case OPCODE+6: SWITCH_ ## OP_NAME(cycleRead<FAST>(HL)) break; \
+	case OPCODE+7: SWITCH_ ## OP_NAME(A) break;
+
+template <bool FAST>
+void CPU::stepInstruction() {
+	PROFILE(u64 profile_begin = cycle_count;)
+	if (!FAST) {
+		cycle_count++;
+		if (cycle_count > memory->gb->scheduler.next) memory->gb->catchUp(); // IRQs
+	}
+
+	// TODO: handle more IRQs
+	if (IME) {
+		u16 irq_address = 0;
+		if (memory->io.IE_vblank && memory->io.IF_vblank) {
+			irq_address = IRQ_ADR_VBLANK;
+			memory->io.IF_vblank = 0;
+		} else if (memory->io.IE_lcd_stat && memory->io.IF_lcd_stat) {
+			irq_address = IRQ_ADR_LCDSTAT;
+			memory->io.IF_lcd_stat = 0;
+		} else if (memory->io.IE_timer && memory->io.IF_timer) {
+			irq_address = IRQ_ADR_TIMER;
+			memory->io.IF_timer = 0;
+		}
+		if (irq_address) {
+			IME = false;
+			halted = false;
+			if (!FAST) cycle_count += 2;
+			cycleWrite<FAST>(--SP, PC >> 8);
+			cycleWrite<FAST>(--SP, PC);
+			PC = irq_address;
+			cycle_count += FAST ? 12 : 1;
+			PROFILE(profiler.onIRQ(); profiler.onCycles(cycle_count - profile_begin);)
+			return;
+		}
+	}
+	if (halted) {
+		if (FAST) {
+			// only the PPU and the timer end a HALT, skip all the steps up to
+			// the first one past their next deadline
+			u64 next = memory->gb->scheduler.next;
+			u64 steps = 1;
+			if (next != EVENT_NEVER && next >= cycle_count) steps += (next - cycle_count) / 4;
+			cycle_count += 4 * steps;
+		} else {
+			cycle_count += 3;
+		}
+		PROFILE(profiler.onHalt(); profiler.onCycles(cycle_count - profile_begin);)
+		return;
+	}
+
+	u8 opcode;
+	if (FAST) {
+		const DecodedOp *op = memory->gb->block_cache.fetch(this, PC);
+		if (op) {
+			opcode = op->opcode;
+			immediate = op->operand;
+			PC++;
+		} else {
+			opcode = memory->load8(PC++);
+			immediate = nullptr;
+		}
+	} else {
+		opcode = syncedLoad8(PC++);
+		cycle_count += 2;
+	}
+	bus = opcode;
+	PROFILE(profiler.onFetch(memory, PC-1, opcode);)
+
+	executeOpcode<FAST>(opcode);
+
+	if (FAST) {
+		addFastCycles(opcode);
+	} else {
+		cycle_count++;
+	}
+	PROFILE(profiler.onCycles(cycle_count - profile_begin);)
+}
+
+// the switch over all opcodes, always inlined so that executeThreaded<OPCODE>
+// folds it down to a single case
+template <bool FAST>
+ALWAYS_INLINE void CPU::executeOpcode(u8 opcode) {
+	switch (opcode) {
+	case 0x00: break; // NOP
+	case 0x01: SWITCH_LD_D16(B, C) break;
+	case 0x02: cycleWrite<FAST>(BC, A); break;
+	case 0x03: BC++; cycleIdle<FAST>(); break;
+	case 0x04: SWITCH_INC(B) break;
+	case 0x05: SWITCH_DEC(B) break;
+	case 0x06: B = cycleReadPC<FAST>(); break;
+	case 0x07: // RLCA
+		A = (A<<1) | (A>>7);
+		lazy_op = LAZY_NONE;
+		F = (A&1) << 4;
+		break;
+	case 0x08: // LD (a16),SP
+	{
+		u16 a16 = cycleReadPC<FAST>();
+		a16 |= cycleReadPC<FAST>() << 8;
+		cycleWrite<FAST>(a16, P);
+		cycleWrite<FAST>(a16+1, S);
+	} break;
+	case 0x09: SWITCH_ADD_HL(B, C) break;
+	case 0x0A: A = cycleRead<FAST>(BC); break;
+	case 0x0B: BC--; cycleIdle<FAST>(); break;
+	case 0x0C: SWITCH_INC(C) break;
+	case 0x0D: SWITCH_DEC(C) break;
+	case 0x0E: C = cycleReadPC<FAST>(); break;
+	case 0x0F: // RRCA
+	{
+		int low = A&1;
+		A = (A>>1) | (low<<7);
+		lazy_op = LAZY_NONE;
+		F = low << 4;
+	} break;
+
+	case 0x10: // STOP
+		cycleReadPC<FAST>();
+		halted = true;
+		break;
+	case 0x11: SWITCH_LD_D16(D, E) break;
+	case 0x12: cycleWrite<FAST>(DE, A); break;
+	case 0x13: DE++; cycleIdle<FAST>(); break;
+	case 0x14: SWITCH_INC(D) break;
+	case 0x15: SWITCH_DEC(D) break;
+	case 0x16: D = cycleReadPC<FAST>(); break;
+	case 0x17: // RLA
+	{
+		int wide = (A<<1) | flagC();
+		A = wide;
+		lazy_op = LAZY_NONE;
+		F = (wide >> 8) << 4;
+	} break;
+	case 0x18: SWITCH_JR(true) break;
+	case 0x19: SWITCH_ADD_HL(D, E) break;
+	case 0x1A: A = cycleRead<FAST>(DE); break;
+	case 0x1B: DE--; cycleIdle<FAST>(); break;
+	case 0x1C: SWITCH_INC(E) break;
+	case 0x1D: SWITCH_DEC(E) break;
+	case 0x1E: E = cycleReadPC<FAST>(); break;
+	case 0x1F: // RRA
+	{
+		int low = A&1;
+		A = (A>>1) | (flagC()<<7);
+		lazy_op = LAZY_NONE;
+		F = low << 4;
+	} break;
+
+	case 0x20: SWITCH_JR(!flagZ()) break;
+	case 0x21: SWITCH_LD_D16(H, L) break;
+	case 0x22: cycleWrite<FAST>(HL++, A); break;
+	case 0x23: HL++; cycleIdle<FAST>(); break;
+	case 0x24: SWITCH_INC(H) break;
+	case 0x25: SWITCH_DEC(H) break;
+	case 0x26: H = cycleReadPC<FAST>(); break;
+	case 0x27: // DAA
+		syncFlags();
+		if (F_N) {
+			if (F_H) A += 0xFA;
+			if (flagC()) A += 0xA0;
+		} else {
+			int wide = A;
+			if ((wide&0xF) > 0x9 || F_H) wide += 0x6;
+			if ((wide&0x1F0) > 0x90 || F_C) {
+				wide += 0x60;
+				F_C = 1;
+			} else {
+				F_C = 0;
+			}
+			A = wide;
+		}
+		F_H = 0;
+		F_Z = !A;
+		break;
+	case 0x28: SWITCH_JR(flagZ()) break;
+	case 0x29: SWITCH_ADD_HL(H, L) break;
+	case 0x2A: A = cycleRead<FAST>(HL++); break;
+	case 0x2B: HL--; cycleIdle<FAST>(); break;
+	case 0x2C: SWITCH_INC(L) break;
+	case 0x2D: SWITCH_DEC(L) break;
+	case 0x2E: L = cycleReadPC<FAST>(); break;
+	case 0x2F: A = ~A; syncFlags(); F_H = 1; F_N = 1; break; // CPL
+
+	case 0x30: SWITCH_JR(!flagC()) break;
+	case 0x31: SWITCH_LD_D16(S, P) break;
+	case 0x32: cycleWrite<FAST>(HL--, A); break;
+	case 0x33: SP++; cycleIdle<FAST>(); break;
+	case 0x34: // INC (HL)
+	{
+		u8 value = cycleRead<FAST>(HL);
+		SWITCH_INC(value)
+		cycleWrite<FAST>(HL, value);
+	} break;
+	case 0x35: // DEC (HL)
+	{
+		u8 value = cycleRead<FAST>(HL);
+		SWITCH_DEC(value)
+		cycleWrite<FAST>(HL, value);
+	} break;
+	case 0x36: cycleWrite<FAST>(HL, cycleReadPC<FAST>()); break;
+	case 0x37: syncFlags(); F_C = 1; F_N = F_H = 0; break; // SCF
+	case 0x38: SWITCH_JR(flagC()) break;
+	case 0x39: SWITCH_ADD_HL(S, P) break;
+	case 0x3A: A = cycleRead<FAST>(HL--); break;
+	case 0x3B: SP--; cycleIdle<FAST>(); break;
+	case 0x3C: SWITCH_INC(A) break;
+	case 0x3D: SWITCH_DEC(A) break;
+	case 0x3E: A = cycleReadPC<FAST>(); break;
+	case 0x3F: syncFlags(); F_C = !F_C; F_N = F_H = 0; break; // CCF
+
+	SWITCH_CASES_LD(0x40, B)
+	SWITCH_CASES_LD(0x48, C)
+	SWITCH_CASES_LD(0x50, D)
+	SWITCH_CASES_LD(0x58, E)
+	SWITCH_CASES_LD(0x60, H)
+	SWITCH_CASES_LD(0x68, L)
+	case 0x70: cycleWrite<FAST>(HL, B); break;
+	case 0x71: cycleWrite<FAST>(HL, C); break;
+	case 0x72: cycleWrite<FAST>(HL, D); break;
+	case 0x73: cycleWrite<FAST>(HL, E); break;
+	case 0x74: cycleWrite<FAST>(HL, H); break;
+	case 0x75: cycleWrite<FAST>(HL, L); break;
+	case 0x76: halted = true; break; // HALT TODO: halt bug of DMG
+	case 0x77: cycleWrite<FAST>(HL, A); break;
+	SWITCH_CASES_LD(0x78, A)
+
+	SWITCH_CASES_ALU(0x80, ADD)
+	SWITCH_CASES_ALU(0x88, ADC)
+	SWITCH_CASES_ALU(0x90, SUB)
+	SWITCH_CASES_ALU(0x98, SBC)
+	SWITCH_CASES_ALU(0xA0, AND)
+	SWITCH_CASES_ALU(0xA8, XOR)
+	SWITCH_CASES_ALU(0xB0, OR)
+	SWITCH_CASES_ALU(0xB8, CP)
+
+	case 0xC0: SWITCH_RET_CONDITIONAL(!flagZ()) break;
+	case 0xC1: SWITCH_POP(B, C) break;
+	case 0xC2: SWITCH_JP(!flagZ()) break;
+	case 0xC3: SWITCH_JP(true) break;
+	case 0xC4: SWITCH_CALL(!flagZ()) break;
+	case 0xC5: SWITCH_PUSH(B, C) break;
+	case 0xC6: SWITCH_ADD(cycleReadPC<FAST>()) break;
+	case 0xC7: SWITCH_RST(0x00) break;
+	case 0xC8: SWITCH_RET_CONDITIONAL(flagZ()) break;
+	case 0xC9: SWITCH_RET() break;
+	case 0xCA: SWITCH_JP(flagZ()) break;
+	case 0xCB: stepPrefixCB<FAST>(cycleReadPC<FAST>()); break;
+	case 0xCC: SWITCH_CALL(flagZ()) break;
+	case 0xCD: SWITCH_CALL(true) break;
+	case 0xCE: SWITCH_ADC(cycleReadPC<FAST>()) break;
+	case 0xCF: SWITCH_RST(0x08) break;
+
+	case 0xD0: SWITCH_RET_CONDITIONAL(!flagC()) break;
+	case 0xD1: SWITCH_POP(D, E) break;
+	case 0xD2: SWITCH_JP(!flagC()) break;
+	case 0xD4: SWITCH_CALL(!flagC()) break;
+	case 0xD5: SWITCH_PUSH(D, E) break;
+	case 0xD6: SWITCH_SUB(cycleReadPC<FAST>()) break;
+	case 0xD7: SWITCH_RST(0x10) break;
+	case 0xD8: SWITCH_RET_CONDITIONAL(flagC()) break;
+	case 0xD9: ei(); SWITCH_RET() break; // RETI
+	case 0xDA: SWITCH_JP(flagC()) break;
+	case 0xDC: SWITCH_CALL(flagC()) break;
+	case 0xDE: SWITCH_SBC(cycleReadPC<FAST>()) break;
+	case 0xDF: SWITCH_RST(0x18) break;
+
+	case 0xE0: cycleWrite<FAST>(0xFF00 | cycleReadPC<FAST>(), A); break;
+	case 0xE1: SWITCH_POP(H, L) break;
+	case 0xE2: cycleWrite<FAST>(0xFF00 | C, A); break;
+	case 0xE5: SWITCH_PUSH(H, L) break;
+	case 0xE6: SWITCH_AND(cycleReadPC<FAST>()) break;
+	case 0xE7: SWITCH_RST(0x20) break;
+	case 0xE8: // ADD SP,r8
+	{
+		int diff = (s8)cycleReadPC<FAST>(); // signed
+		int sum = SP + diff;
+		lazy_op = LAZY_NONE;
+		F = 0;
+		F_C = (diff&0xFF) + (SP&0xFF) >= 0x100;
+		F_H = (diff&0xF) + (SP&0xF) >= 0x10;
+		cycleIdle<FAST>();
+		SP = sum;
+		cycleIdle<FAST>();
+	} break;
+	case 0xE9: PC = HL; break;
+	case 0xEA: // LD (a16),A
+	{
+		u16 a16 = cycleReadPC<FAST>();
+		a16 |= cycleReadPC<FAST>() << 8;
+		cycleWrite<FAST>(a16, A);
+	} break;
+	case 0xEE: SWITCH_XOR(cycleReadPC<FAST>()) break;
+	case 0xEF: SWITCH_RST(0x28) break;
+
+	case 0xF0: A = cycleRead<FAST>(0xFF00 | cycleReadPC<FAST>()); break;
+	case 0xF1: SWITCH_POP(A, F) F &= 0xF0; lazy_op = LAZY_NONE; break;
+	case 0xF2: A = cycleRead<FAST>(0xFF00 | C); break;
+	case 0xF3: di(); break;
+	case 0xF5: syncFlags(); SWITCH_PUSH(A, F) break;
+	case 0xF6: SWITCH_OR(cycleReadPC<FAST>()) break;
+	case 0xF7: SWITCH_RST(0x30) break;
+	case 0xF8: // LD HL,SP+r8
+	{
+		int diff = (s8)cycleReadPC<FAST>(); // signed
+		int sum = SP + diff;
+		lazy_op = LAZY_NONE;
+		F = 0;
+		F_C = (diff&0xFF) + (SP&0xFF) >= 0x100;
+		F_H = (diff&0xF) + (SP&0xF) >= 0x10;
+		HL = sum;
+		cycleIdle<FAST>();
+	} break;
+	case 0xF9: SP = HL; cycleIdle<FAST>(); break;
+	case 0xFA: // LD A,(a16)
+	{
+		u16 a16 = cycleReadPC<FAST>();
+		a16 |= cycleReadPC<FAST>() << 8;
+		A = cycleRead<FAST>(a16);
+	} break;
+	case 0xFB: ei(); break;
+	case 0xFE: SWITCH_CP(cycleReadPC<FAST>()) break;
+	case 0xFF: SWITCH_RST(0x38) break;
+
+	default: // 0xD3 0xDB 0xDD 0xE3 0xE4 0xEB 0xEC 0xED 0xF4 0xFC 0xFD
+		DEBUG_illegal_instruction = true;
+		break;
+	}
+}
+
+void CPU::addFastCycles(u8 opcode) {
+	const InstructionInfo &info = instruction_infos[opcode];
+	cycle_count += (condition && info.cycles_branch) ? info.cycles_branch : info.cycles;
+}
+
+template <bool FAST>
+void CPU::stepPrefixCB(u8 opcode) {
+	PROFILE(profiler.onFetchCB(opcode);)
+	// instruction_infos only covers the prefix and operand fetch
+	if (FAST && (opcode&0x7) == 6) cycle_count += (opcode>>6) == 1 ? 4 : 8;
+
+	int reg = 0;
+	switch (opcode&0x7) {
+	case 0: reg = B; break;
+	case 1: reg = C; break;
+	case 2: reg = D; break;
+	case 3: reg = E; break;
+	case 4: reg = H; break;
+	case 5: reg = L; break;
+	case 6: reg = cycleRead<FAST>(HL); break;
+	case 7: reg = A; break;
+	}
+
+	u8 bit = 1 << ((opcode>>3)&0x7);
+	switch (opcode>>6) {
+	case 0: // rotates and shifts
+	{
+		int carry = 0;
+		switch (opcode>>3) {
+		case 0: reg = (reg<<1) | (reg>>7); carry = reg&1; break; // RLC
+		case 1: carry = reg&1; reg = (reg>>1) | (carry<<7); break; // RRC
+		case 2: { int wide = (reg<<1) | flagC(); reg = wide; carry = wide>>8; } break; // RL
+		case 3: { int low = reg&1; reg = (reg>>1) | (flagC()<<7); carry = low; } break; // RR
+		case 4: carry = reg>>7; reg <<= 1; break; // SLA
+		case 5: carry = reg&1; reg = ((s8)reg) >> 1; break; // SRA
+		case 6: reg = (reg<<4) | (reg>>4); break; // SWAP
+		case 7: carry = reg&1; reg >>= 1; break; // SRL
+		}
+		lazy_res = (reg&0xFF) | (carry<<8);
+		lazy_op = LAZY_OR;
+	} break;
+	case 1: // BIT (carry is kept)
+		lazy_res = (reg&bit) | (flagC()<<8);
+		lazy_op = LAZY_AND;
+		return; // no write back
+	case 2: reg &= ~bit; break; // RES
+	case 3: reg |= bit; break; // SET
+	}
+
+	switch (opcode&0x7) {
+	case 0: B = reg; break;
+	case 1: C = reg; break;
+	case 2: D = reg; break;
+	case 3: E = reg; break;
+	case 4: H = reg; break;
+	case 5: L = reg; break;
+	case 6: cycleWrite<FAST>(HL, reg); break;
+	case 7: A = reg; break;
+	}
+}
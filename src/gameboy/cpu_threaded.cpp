@@ -0,0 +1,63 @@
+// threaded code backend for the block mode
+// the ops of a predecoded block are run back to back through handlers in
+// which the opcode switch is already resolved at compile time. hot blocks
+// are compiled to x86-64 with jit_mode (cpu_jit.cpp), this is what runs on
+// other hosts and until then.
+// a block stops early when a scheduler deadline passes, so IRQs are taken
+// at the same instruction as in the fast mode.
+
+template <int OPCODE>
+void CPU::executeThreaded() {
+	executeOpcode<true>(OPCODE);
+}
+
+#define THREADED_OPS_16(HI) \
+	&CPU::executeThreaded<HI+0x0>, &CPU::executeThreaded<HI+0x1>, \
+	&CPU::executeThreaded<HI+0x2>, &CPU::executeThreaded<HI+0x3>, \
+	&CPU::executeThreaded<HI+0x4>, &CPU::executeThreaded<HI+0x5>, \
+	&CPU::executeThreaded<HI+0x6>, &CPU::executeThreaded<HI+0x7>, \
+	&CPU::executeThreaded<HI+0x8>, &CPU::executeThreaded<HI+0x9>, \
+	&CPU::executeThreaded<HI+0xA>, &CPU::executeThreaded<HI+0xB>, \
+	&CPU::executeThreaded<HI+0xC>, &CPU::executeThreaded<HI+0xD>, \
+	&CPU::executeThreaded<HI+0xE>, &CPU::executeThreaded<HI+0xF>
+
+const CPU::Instruction CPU::threaded_ops[0x100] = {
+	THREADED_OPS_16(0x00), THREADED_OPS_16(0x10),
+	THREADED_OPS_16(0x20), THREADED_OPS_16(0x30),
+	THREADED_OPS_16(0x40), THREADED_OPS_16(0x50),
+	THREADED_OPS_16(0x60), THREADED_OPS_16(0x70),
+	THREADED_OPS_16(0x80), THREADED_OPS_16(0x90),
+	THREADED_OPS_16(0xA0), THREADED_OPS_16(0xB0),
+	THREADED_OPS_16(0xC0), THREADED_OPS_16(0xD0),
+	THREADED_OPS_16(0xE0), THREADED_OPS_16(0xF0),
+};
+
+bool CPU::runBlock() {
+	// TODO: handle more IRQs
+	if (halted || (IME && (memory->io.IE & memory->io.IF & 0x07))) return false;
+
+	BlockCache *block_cache = &memory->gb->block_cache;
+	const DecodedOp *op = block_cache->fetch(this, PC);
+	if (!op) return false;
+	Block *block = block_cache->block;
+#ifdef CPU_JIT_X86
+	if (memory->gb->jit_mode && runJit(block, op)) return true;
+#endif
+
+	for (;;) {
+		PROFILE(u64 profile_begin = cycle_count; profiler.onFetch(memory, PC, op->opcode);)
+		immediate = op->operand;
+		PC++;
+		bus = op->opcode;
+		(this->*threaded_ops[op->opcode])();
+		addFastCycles(op->opcode);
+		PROFILE(profiler.onCycles(cycle_count - profile_begin);)
+
+		// a bank switch or a store to the block's WRAM resets the cursor
+		if (block_cache->block != block || block_cache->block_index >= block->op_count) break;
+		if (cycle_count > memory->gb->scheduler.next) break; // IRQs might be due
+		if (memory->watch_hit >= 0) break; // the frontend stops on it
+		op = block_cache->fetch(this, PC);
+	}
+	return true;
+}
@@ -1,25 +1,219 @@
 void GameBoy::init() {
-	audio_buffer.set_sample_rate(AUDIO_SAMPLE_RATE);
-	audio_buffer.clock_rate(CPU_FREQ_HZ);
-	apu.output(audio_buffer.center(), audio_buffer.left(), audio_buffer.right());
-
+	initAudio();
 	memory.gb = this;
 	cpu.memory = &memory;
 	ppu.gb = this;
 	reset();
 }
 
+void GameBoy::initAudio() {
+	audio_buffer.set_sample_rate(AUDIO_SAMPLE_RATE);
+	audio_buffer.clock_rate(CPU_FREQ_HZ);
+	apu.output(audio_buffer.center(), audio_buffer.left(), audio_buffer.right());
+	audio_initialized = true;
+}
+
+void GameBoy::endAudioFrame() {
+	if (!audio_initialized) initAudio(); // a fork, on its first frame
+	u64 frame_cycle_count = cpu.cycle_count - frame_begin_cycle_count;
+	bool stereo = apu.end_frame(frame_cycle_count);
+	audio_buffer.end_frame(frame_cycle_count, stereo);
+}
+
 void GameBoy::reset() {
 	cpu.reset();
+	block_cache.invalidateAll();
 	ppu.reset();
-	apu.reset(); frame_begin_cycle_count = 0;
+	apu.reset(); frame_begin_cycle_count = 0; apu_begin_cycle_count = 0;
 	memory.reset();
 	running = false;
+	sync_cycle_count = 0;
+	scheduler.reset();
+	idle_loop.reset();
+}
+
+GameBoy *GameBoy::fork() {
+	// no init(): everything it resets is copied below, and the audio buffer
+	// setup is most of the cost of a fork, the child does it in its first
+	// endAudioFrame()
+	GameBoy *child = new GameBoy;
+
+	// copy every member, then fix the pointers into this GameBoy
+	// (block_cache and jit stay empty, the child decodes and compiles again)
+	child->cpu = cpu;
+	child->cpu.memory = &child->memory;
+	child->cpu.immediate = nullptr;
+	PROFILE(child->cpu.profiler.cycle_counts = nullptr;) // owned by this one
+	PROFILE(child->cpu.profiler.reset(memory.rom_size);)
+
+	child->ppu = ppu;
+	child->ppu.gb = child;
+	child->ppu.tile_cache.tiles = nullptr; // owned by this one, decoded again
+
+	child->memory = memory;
+	child->memory.gb = child;
+	if (memory.rom) retainROM(memory.rom);
+	if (memory.sram) {
+		child->memory.sram = new u8[memory.sram_size];
+		memcpy(child->memory.sram, memory.sram, memory.sram_size);
+		child->memory.sram_bank = child->memory.sram + (memory.sram_bank - memory.sram);
+	}
+	child->memory.sram_mapped = false;
+	child->memory.sram_fd = -1;
+	child->memory.map_sram = false;
+	child->memory.sav_filepath[0] = '\0';
+	child->memory.updatePages(0, PAGE_COUNT-1);
+
+	// Gb_Apu can't be copied, write its registers with the triggers masked
+	// (even without audio_enabled, the child might turn it on)
+	child->audio_enabled = audio_enabled;
+	const u8 *regs = (const u8*)&memory.io;
+	child->apu.write_register(0, REG_NR52 + ADR_IO, regs[REG_NR52]); // power
+	for (int adr = Gb_Apu::start_addr; adr <= Gb_Apu::end_addr; adr++) {
+		u8 value = regs[adr - ADR_IO];
+		if (adr == ADR_IO + REG_NR14 || adr == ADR_IO + REG_NR24
+		 || adr == ADR_IO + REG_NR34 || adr == ADR_IO + REG_NR44) value &= 0x7F;
+		child->apu.write_register(0, adr, value);
+	}
+
+	child->button_right = button_right;
+	child->button_left = button_left;
+	child->button_up = button_up;
+	child->button_down = button_down;
+	child->button_a = button_a;
+	child->button_b = button_b;
+	child->button_select = button_select;
+	child->button_start = button_start;
+	child->frame_begin_cycle_count = cpu.cycle_count; // the new APU frame
+	child->apu_begin_cycle_count = cpu.cycle_count;
+	child->running = running;
+	child->fast_mode = fast_mode;
+	child->block_mode = block_mode;
+	child->jit_mode = jit_mode;
+	child->idle_loop_skip = idle_loop_skip;
+	child->idle_loop = idle_loop;
+	child->sync_cycle_count = sync_cycle_count;
+	child->scheduler = scheduler;
+	return child;
 }
 
 void GameBoy::step() {
+	// only switch modes between instructions of the micro-op core
+	if (fast_mode && cpu.state == CPU_STATE_FETCH) {
+		u16 pc = cpu.PC;
+		cpu.stepInstruction<true>();
+		if (cpu.cycle_count > scheduler.next) catchUp();
+		if (memory.watch_hit >= 0) return; // don't skip past a watchpoint
+		if (idle_loop_skip && cpu.PC <= pc && pc - cpu.PC <= IDLE_LOOP_MAX_BYTES) skipIdleLoop();
+		return;
+	}
+	if (skipHalt()) return;
 	cpu.step();
-	ppu.step();
+	if (cpu.cycle_count > scheduler.next) catchUp();
+}
+
+void GameBoy::stepBlock() {
+	// breakpoints are checked between steps
+	if (!block_mode || cpu.state != CPU_STATE_FETCH || cpu.DEBUG_break_point != 0xFFFF) {
+		step();
+		return;
+	}
+	u16 pc = cpu.PC;
+	if (!cpu.runBlock()) cpu.stepInstruction<true>();
+	if (cpu.cycle_count > scheduler.next) catchUp();
+	if (memory.watch_hit >= 0) return; // don't skip past a watchpoint
+	if (idle_loop_skip && cpu.PC <= pc && pc - cpu.PC <= IDLE_LOOP_MAX_BYTES) skipIdleLoop();
+}
+
+void GameBoy::catchUp() {
+	cpu.updateTimers(sync_cycle_count, cpu.cycle_count);
+	// the PPU steps whole M-cycles, an access of the accurate mode happens
+	// one cycle into the current one and sees the PPU before it
+	u64 end = cpu.cycle_count & ~(u64)3;
+	if (memory.dma_active) memory.advanceDMA(end); // before the PPU reads OAM
+	ppu.stepTo(ppu.cycle_count + (end - (sync_cycle_count & ~(u64)3)));
+	sync_cycle_count = cpu.cycle_count;
+	scheduleEvents();
+}
+
+// accurate mode: the halted M-cycles before the next PPU or timer event only
+// advance the clocks, so run them as one batch
+bool GameBoy::skipHalt() {
+	if (!cpu.halted || cpu.state != CPU_STATE_FETCH) return false;
+	if (cpu.IME && (memory.io.IE & memory.io.IF & 0x07)) return false; // IRQ due
+	scheduleEvents();
+	u64 next = scheduler.next;
+	if (next == EVENT_NEVER || next <= cpu.cycle_count) return false;
+	u64 cycles = (next - cpu.cycle_count + 3) & ~(u64)3; // stop at the event
+	cpu.cycle_count += cycles;
+	PROFILE(cpu.profiler.onHalt(); cpu.profiler.onCycles(cycles);)
+	catchUp();
+	return true;
+}
+
+void GameBoy::skipIdleLoop() {
+	IdleLoop *loop = &idle_loop;
+	cpu.syncFlags();
+	u64 now = cpu.cycle_count;
+	bool repeated = loop->cycle != EVENT_NEVER && !loop->dirty && loop->pc == cpu.PC
+		&& loop->AF == cpu.AF && loop->BC == cpu.BC && loop->DE == cpu.DE
+		&& loop->HL == cpu.HL && loop->SP == cpu.SP && loop->IME == cpu.IME
+		&& now > loop->cycle && now - loop->cycle <= IDLE_LOOP_MAX_CYCLES
+		&& !(cpu.IME && (memory.io.IE & memory.io.IF & 0x1F));
+	if (repeated) {
+		// the polled registers keep their values up to (and including) quiet
+		u64 quiet = scheduler.next < loop->next_event ? scheduler.next : loop->next_event;
+		if (loop->reads_div && loop->next_div < quiet) quiet = loop->next_div;
+		if (loop->reads_apu && loop->next_apu < quiet) quiet = loop->next_apu;
+		if (loop->reads_tima && memory.io.TAC_stop == 1) {
+			int shift = cpu.timerShift();
+			u64 round = (1 << shift) - 1;
+			u64 tick = (loop->cycle + round) & ~round;
+			if (tick < quiet) quiet = tick;
+		}
+		// the last iteration saw no change, neither will the skipped ones
+		if (quiet != EVENT_NEVER && quiet >= now) {
+			u64 length = now - loop->cycle;
+			u64 skip = (quiet - now) / length * length;
+			cpu.cycle_count += skip;
+			loop->skipped_cycles += skip;
+			PROFILE(cpu.profiler.cycle_counts[cpu.profiler.locate(&memory, cpu.PC)] += skip;)
+			now = cpu.cycle_count;
+		}
+	}
+
+	// start observing the next iteration
+	loop->pc = cpu.PC;
+	loop->cycle = now;
+	loop->next_event = scheduler.next;
+	loop->next_div = scheduler.deadlines[EVENT_DIV];
+	loop->next_apu = scheduler.deadlines[EVENT_APU];
+	loop->AF = cpu.AF;
+	loop->BC = cpu.BC;
+	loop->DE = cpu.DE;
+	loop->HL = cpu.HL;
+	loop->SP = cpu.SP;
+	loop->IME = cpu.IME;
+	loop->dirty = false;
+	loop->reads_div = false;
+	loop->reads_tima = false;
+	loop->reads_apu = false;
+}
+
+void GameBoy::scheduleEvents() {
+	// the PPU step beginning at ppu.cycle_count runs at the start of the
+	// M-cycle sync_cycle_count is in
+	scheduler.deadlines[EVENT_PPU] = ppu.nextEventCycle();
+	if (scheduler.deadlines[EVENT_PPU] != EVENT_NEVER) {
+		scheduler.deadlines[EVENT_PPU] += (sync_cycle_count & ~(u64)3) - ppu.cycle_count;
+	}
+	scheduler.deadlines[EVENT_TIMER] = cpu.nextTimerOverflow(sync_cycle_count);
+	scheduler.deadlines[EVENT_DMA] = memory.dma_active ? memory.dmaEndCycle() : EVENT_NEVER;
+	scheduler.deadlines[EVENT_SYNC] = EVENT_NEVER;
+	scheduler.deadlines[EVENT_DIV] = (sync_cycle_count + 0xFF) & ~(u64)0xFF;
+	u64 apu_phase = (sync_cycle_count - apu_begin_cycle_count) % APU_FRAME_CYCLES;
+	scheduler.deadlines[EVENT_APU] = sync_cycle_count + (apu_phase ? APU_FRAME_CYCLES - apu_phase : 0);
+	scheduler.updateNext();
 }
 
 void GameBoy::enableLCD() {
@@ -34,15 +228,15 @@ void GameBoy::onIORead(u16 address) {
 	switch (address) {
 	case REG_INPUT:
 		if (!memory.io.INPUT_select_buttons) {
-			memory.io.INPUT_a = !button_a.down();
-			memory.io.INPUT_b = !button_b.down();
-			memory.io.INPUT_select = !button_select.down();
-			memory.io.INPUT_start = !button_start.down();
+			memory.io.INPUT_a = !button_a;
+			memory.io.INPUT_b = !button_b;
+			memory.io.INPUT_select = !button_select;
+			memory.io.INPUT_start = !button_start;
 		} else if (!memory.io.INPUT_select_directions) {
-			memory.io.INPUT_right = !button_right.down();
-			memory.io.INPUT_left = !button_left.down();
-			memory.io.INPUT_up = !button_up.down();
-			memory.io.INPUT_down = !button_down.down();
+			memory.io.INPUT_right = !button_right;
+			memory.io.INPUT_left = !button_left;
+			memory.io.INPUT_up = !button_up;
+			memory.io.INPUT_down = !button_down;
 		}
 		break;
 	default: break;
@@ -52,8 +246,12 @@ u8 GameBoy::onIOWrite(u16 address, u8 value) {
 	switch (address) {
 	case REG_DIV:
 		return 0; // writes reset DIV to 0
+	case REG_SCY: case REG_SCX: case REG_BGP: case REG_OBP0: case REG_OBP1: case REG_WY: case REG_WX:
+		ppu.onRegisterWrite();
+		break;
 	case REG_LCDC:
 	{
+		ppu.onRegisterWrite();
 		bool was_enabled = memory.io.LCDC_enable;
 		memory.io.LCDC = value;
 		if (!was_enabled && memory.io.LCDC_enable) {
@@ -63,7 +261,7 @@ u8 GameBoy::onIOWrite(u16 address, u8 value) {
 	case REG_DMA:
 	{
 		u16 src_address = value<<8;
-		memory.DMAtoOAM(src_address);
+		memory.startDMA(src_address, cpu.cycle_count);
 	} break;
 	default: break;
 	}
@@ -73,8 +271,30 @@ u8 GameBoy::onIOWrite(u16 address, u8 value) {
 
 void GameBoy::loadROM(const char *filepath) {
 	memory.loadROM(filepath);
+	block_cache.invalidateAll();
 	if (memory.rom) { // success
+		apu_begin_cycle_count -= cpu.cycle_count; // the APU keeps its time
 		cpu.reset();
 		ppu.reset();
+		sync_cycle_count = 0;
+		scheduler.reset();
+		idle_loop.reset();
 	}
 }
+
+void GameBoy::skipBootROM() {
+	cpu.AF = 0x01B0;
+	cpu.lazy_op = LAZY_NONE;
+	cpu.BC = 0x0013;
+	cpu.DE = 0x00D8;
+	cpu.HL = 0x014D;
+	cpu.SP = 0xFFFE;
+	cpu.PC = 0x0100;
+
+	memory.io.LCDC = 0x91;
+	memory.io.BGP  = 0xFC;
+	memory.io.OBP0 = 0xFF;
+	memory.io.OBP1 = 0xFF;
+	memory.io.BOOT = 1;
+	memory.updatePages(0, 0);
+}
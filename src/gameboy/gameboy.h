@@ -1,10 +1,9 @@
 /*
 TODO:
-DMA within 160 cycles (not instant)
 input interrupt
 serial interrupt
 serial
-memory bank controllers MBC1 √ MBC2 √ MBC3 MBC5
+memory bank controllers MBC1 √ MBC2 √ MBC3 √ MBC5 √
 actually guard SRAM if sram_enabled becomes false
 proper halt/stop behavior
 LCD disable
@@ -16,35 +15,70 @@ const int RAM_FREQ_HZ  = 1<<20; // 1 MiHz
 const int PPU_FREQ_HZ  = 4<<20; // 4 MiHz
 const int VRAM_FREQ_HZ = 2<<20; // 2 MiHz
 
+const int AUDIO_SAMPLE_RATE = 44100;
+const int APU_FRAME_CYCLES = CPU_FREQ_HZ / 256; // Gb_Apu's frame sequencer period
+
 struct GameBoy {
 	CPU cpu;
+	// fast modes: the CPU's predecoded blocks (block_cache.h) and their
+	// compiled code (jit.h), kept out of CPU so it stays register state
+	BlockCache block_cache;
+	Jit jit;
 	PPU ppu;
 	Gb_Apu apu;
 	Memory memory;
 
-	// input
-	ButtonState button_right;
-	ButtonState button_left;
-	ButtonState button_up;
-	ButtonState button_down;
-	ButtonState button_a;
-	ButtonState button_b;
-	ButtonState button_select;
-	ButtonState button_start;
+	// input (true=pressed, set by the frontend)
+	bool button_right = false;
+	bool button_left = false;
+	bool button_up = false;
+	bool button_down = false;
+	bool button_a = false;
+	bool button_b = false;
+	bool button_select = false;
+	bool button_start = false;
 
 	// audio output
 	bool audio_enabled = true;
 	u64 frame_begin_cycle_count;
+	u64 apu_begin_cycle_count; // the frame sequencer ticks every APU_FRAME_CYCLES from here
 	Stereo_Buffer audio_buffer;
+	bool audio_initialized = false; // audio_buffer is set up (initAudio)
 
 	bool running = false;
+	// run whole instructions and catch up PPU and timers afterwards,
+	// faster but the PPU lags up to one instruction behind the CPU
+	bool fast_mode = false;
+	// like fast_mode, but whole ROM blocks at once (see cpu_threaded.cpp)
+	bool block_mode = false;
+	// block_mode with the blocks compiled to x86-64 (see jit.h)
+	bool jit_mode = false;
+	// fast modes: skip the iterations of polling loops (see idle_loop.h)
+	bool idle_loop_skip = false;
+	IdleLoop idle_loop;
 
 	void init();
+	void initAudio(); // set up audio_buffer, part of init()
+	// end the APU frame begun at frame_begin_cycle_count, its samples are
+	// in audio_buffer then (sets it up first if needed)
+	void endAudioFrame();
 
 	void loadROM(const char *filepath);
+	void skipBootROM(); // set up the state the boot rom leaves behind
 
 	void reset();
+	// a new GameBoy in the same state, sharing the ROM: the block cache
+	// starts empty, SRAM isn't saved and the APU restarts from its registers,
+	// the audio buffer is only set up by its first endAudioFrame()
+	GameBoy *fork();
 	void step();
+	void stepBlock(); // a whole block in block_mode, otherwise step()
+	u64 sync_cycle_count = 0; // PPU and timers are up to date until here
+	Scheduler scheduler;
+	void catchUp(); // step PPU and timers up to cpu.cycle_count
+	void scheduleEvents();
+	bool skipHalt(); // fast-forward a halted CPU, false if it has to step
+	void skipIdleLoop(); // after a small backward jump
 
 	void enableLCD(); // basically resets the LCD
 
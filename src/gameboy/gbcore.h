@@ -0,0 +1,17 @@
+// emulation core, only the ROM cache and mapped SRAM depend on POSIX (mmap)
+// expects system/defines.h, system/log.h, system/files.h
+// and the Gb_Apu headers to be included before
+
+#include "pixel_decode.h"
+#include "tile_cache.h"
+#include "ppu.h"
+#include "bus_trace.h"
+#include "memory.h"
+#include "rom_cache.h"
+#include "block_cache.h"
+#include "jit.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "idle_loop.h"
+#include "cpu.h"
+#include "gameboy.h"
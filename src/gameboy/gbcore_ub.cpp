@@ -0,0 +1,36 @@
+#include <cstring>
+#include <cassert>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "system/defines.h"
+#include "system/log.h"
+#include "system/files.h"
+
+#include <Gb_Apu.h>
+#include <Multi_Buffer.h>
+
+#include "gbcore.h"
+
+#include "cpu.cpp"
+#include "cpu_tables.cpp"
+#include "cpu_switch.cpp"
+#include "cpu_threaded.cpp"
+#include "cpu_jit.cpp"
+#include "block_cache.cpp"
+#include "profiler.cpp"
+#include "bus_trace.cpp"
+#include "pixel_decode.cpp"
+#include "tile_cache.cpp"
+#include "ppu.cpp"
+#include "memory.cpp"
+#include "rom_cache.cpp"
+#include "gameboy.cpp"
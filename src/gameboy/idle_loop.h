@@ -0,0 +1,45 @@
+// polling loops in the fast modes (GameBoy::skipIdleLoop)
+// a loop that comes back to the same PC with the same registers, without
+// having written memory or read anything that changes by itself, repeats
+// exactly until the PPU, the timers or the APU change what it polls
+
+const int IDLE_LOOP_MAX_BYTES  = 32;  // distance of the backward jump
+const int IDLE_LOOP_MAX_CYCLES = 256; // length of one iteration
+
+struct IdleLoop {
+	// state at the start of the last iteration
+	u16 pc = 0;
+	u64 cycle = EVENT_NEVER; // EVENT_NEVER: none yet
+	u64 next_event = 0; // scheduler.next back then
+	u64 next_div = 0, next_apu = 0; // and the deadlines of EVENT_DIV/EVENT_APU
+	u16 AF, BC, DE, HL, SP;
+	u8 IME;
+
+	// what the iteration did
+	bool dirty = true; // wrote memory or read an unpredictable register
+	bool reads_div = false;
+	bool reads_tima = false;
+	bool reads_apu = false;
+
+	u64 skipped_cycles = 0;
+
+	void reset() {
+		cycle = EVENT_NEVER;
+		dirty = true;
+	}
+	void onWrite() { dirty = true; }
+	void onRead(u16 address) { // VRAM, OAM and IO (see needsSync)
+		if (address < ADR_IO || address == ADR_IE) return;
+		int reg = address - ADR_IO;
+		if (reg == REG_DIV) {
+			reads_div = true;
+		} else if (reg == REG_TIMA) {
+			reads_tima = true;
+		} else if (address >= Gb_Apu::start_addr && address <= Gb_Apu::end_addr) {
+			reads_apu = true;
+		} else if (reg != REG_INPUT && reg != REG_TMA && reg != REG_TAC && reg != REG_IF
+		        && (reg < REG_LCDC || reg > REG_LCDC + 0x0B)) {
+			dirty = true; // serial changes on its own
+		}
+	}
+};
@@ -13,11 +13,27 @@ const int REG_TAC  = 0x07;
 
 // LCD
 const int REG_LCDC = 0x40;
+const int REG_SCY  = 0x42;
+const int REG_SCX  = 0x43;
 const int REG_BGP  = 0X47;
+const int REG_OBP0 = 0x48;
+const int REG_OBP1 = 0x49;
+const int REG_WY   = 0x4A;
+const int REG_WX   = 0x4B;
+
+// sound, bit 7 of NRx4 restarts the channel
+const int REG_NR14 = 0x14;
+const int REG_NR24 = 0x19;
+const int REG_NR34 = 0x1E;
+const int REG_NR44 = 0x23;
+const int REG_NR52 = 0x26; // sound on/off
 
 // DMA
 const int REG_DMA = 0x46; // source address XX00-XX9F
 
+// boot rom
+const int REG_BOOT = 0x50; // writing 1 unmaps the boot rom
+
 // interrupt
 const int REG_IF = 0x0F; // individual interrupt requests
 const int REG_IE = 0xFF; // enable individual interrupts
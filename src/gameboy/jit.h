@@ -0,0 +1,44 @@
+// x86-64 code for the blocks of the block cache (cpu_jit.cpp), used by the
+// block mode with GameBoy::jit_mode set. the guest registers live in host
+// registers while a block runs, ROM/WRAM/HRAM accesses go through the page
+// tables inline, everything else calls into the interpreter
+// other hosts and profiled builds keep the threaded code (cpu_threaded.cpp)
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(_WIN32) && !defined(USE_PROFILER)
+#define CPU_JIT_X86
+#endif
+
+const int JIT_BUFFER_SIZE = 1<<20; // per GameBoy, flushed when full
+const int JIT_MAX_BLOCK_SIZE = 16<<10; // code of one block, hot and cold part
+const int JIT_HOT_RUNS = 4; // a block is compiled on its 4th run
+
+// header of a compiled block, its code follows
+struct JitBlock {
+	u16 entries[BLOCK_MAX_OPS]; // offset of each op's code from the header
+	u16 pending[BLOCK_MAX_OPS]; // cycles the code adds later for the ops before it
+	s8 flags[BLOCK_MAX_OPS]; // LazyOp the code expects at each op, -1: any
+};
+
+struct CPU;
+
+// the compiled code works relative to the CPU (the block cache and the Jit
+// sit next to it in GameBoy), the helpers it calls keep the scheduler
+// deadline as a budget
+typedef void (*JitEnterFn)(CPU *cpu, const u8 *code);
+
+struct Jit {
+	u8 *buffer = nullptr; // RWX, mapped on first use
+	int used = 0;
+	int stubs_size = 0; // enter and leave at the start
+	bool failed = false; // no executable memory, blocks stay threaded
+	JitEnterFn enter; // loads the guest registers and jumps to code
+	const u8 *leave; // stores them and returns from enter
+	// cycles to the scheduler deadline relative to cycle_count, the code
+	// leaves after the op that uses it up, -1: leave after the current op
+	s64 budget;
+
+	u64 DEBUG_compile_count = 0;
+	u64 DEBUG_flush_count = 0;
+
+	~Jit();
+};
@@ -1,19 +1,35 @@
 void Memory::init() {
 	assert(sizeof(IO) == 0x100);
 	reset();
+	unloadROM();
+	mbc = &Memory::mbc0;
+}
+
+Memory::~Memory() {
+	unloadROM();
+}
 
-	if (rom) { delete [] rom; }
+void Memory::unloadROM() {
+	if (rom) { releaseROM(rom); }
 	rom = nullptr;
 	rom_size = 0;
 	rom_bank0 = nullptr;
 	rom_bank1 = nullptr;
 
-	if (sram) { delete [] sram; }
+	if (sram_mapped) {
+		if (has_rtc) saveRTC(); // a mapped SRAM is always saved
+		munmap(sram, sram_size);
+		close(sram_fd); // releases the lock
+		sram_fd = -1;
+	} else if (sram) {
+		delete [] sram;
+	}
 	sram = nullptr;
 	sram_size = 0;
 	sram_bank = nullptr;
-
-	mbc = &Memory::mbc0;
+	sram_mapped = false;
+	sav_filepath[0] = '\0';
+	has_rtc = false;
 }
 
 void Memory::reset() {
@@ -22,6 +38,10 @@ void Memory::reset() {
 	memset(&oam, 0, sizeof(oam));
 	memset(&io,  0, sizeof(io));
 	memset(hram, 0, sizeof(hram));
+	unmapped = 0;
+	mbc1_state = {};
+	rtc = {};
+	mbc5_rom_bank = 1;
 
 	if (rom) {
 		rom_bank0 = rom;
@@ -33,11 +53,32 @@ void Memory::reset() {
 	}
 
 	sram_enabled = false;
+	dma_active = false;
+	updatePages(0, PAGE_COUNT-1);
 }
 
 u8 Memory::load8(u16 address) {
+	const u8 *page = read_pages[address >> PAGE_SHIFT];
+	if (page) return page[address & (PAGE_SIZE-1)];
+
+	u8 value = load8Slow(address);
+	BUS_TRACE(if (bus_trace.enabled) bus_trace.record(gb->cpu.cycle_count, gb->cpu.PC, address, value, 0);)
+	return value;
+}
+
+u8 Memory::load8Slow(u16 address) {
+	if (watched_pages[address >> PAGE_SHIFT]) {
+		// the fetch of the opcode or an operand byte has PC just past it
+		u8 flags = address == (u16)(gb->cpu.PC - 1) ? WATCH_EXECUTE : WATCH_READ;
+		checkWatchpoints(address, flags, *map(address));
+	}
+	if (dma_active && address < ADR_IO) {
+		advanceDMA(gb->cpu.cycle_count);
+		if (dma_active) return 0xFF; // bus taken by the DMA
+	}
 	if ((address >= ADR_IO && address < ADR_IO+SIZE_IO) || address == ADR_IE) {
 		gb->onIORead(address - ADR_IO);
+		PROFILE(gb->cpu.profiler.io_read_counts[address - ADR_IO]++;)
 	}
 	if (address >= gb->apu.start_addr && address <= gb->apu.end_addr) {
 		u64 frame_cycle_count = gb->cpu.cycle_count - gb->frame_begin_cycle_count;
@@ -49,11 +90,26 @@ u8 Memory::load8(u16 address) {
 }
 
 void Memory::store8(u16 address, u8 value) {
+	u8 *page = write_pages[address >> PAGE_SHIFT];
+	if (page) {
+		page[address & (PAGE_SIZE-1)] = value;
+		return;
+	}
+	BUS_TRACE(if (bus_trace.enabled) bus_trace.record(gb->cpu.cycle_count, gb->cpu.PC, address, value, BUS_ACCESS_WRITE);)
+
+	if (watched_pages[address >> PAGE_SHIFT]) checkWatchpoints(address, WATCH_WRITE, value);
+	if (dma_active && address < ADR_IO) {
+		advanceDMA(gb->cpu.cycle_count);
+		if (dma_active) return; // bus taken by the DMA
+	}
 	if (address < ADR_ROM_BANK0 + 2*SIZE_ROM_BANK) { // ROM
 		(this->*mbc)(address, value);
+	} else if (rtc.select && address >= ADR_RAM_EXTERNAL && address < ADR_RAM_INTERNAL_BANK0) {
+		writeRTC(value);
 	} else {
 		if ((address >= ADR_IO && address < ADR_IO+SIZE_IO) || address == ADR_IE) {
 			value = gb->onIOWrite(address - ADR_IO, value);
+			PROFILE(gb->cpu.profiler.io_write_counts[address - ADR_IO]++;)
 		}
 		if (address >= gb->apu.start_addr && address <= gb->apu.end_addr) {
 			u64 frame_cycle_count = gb->cpu.cycle_count - gb->frame_begin_cycle_count;
@@ -61,13 +117,29 @@ void Memory::store8(u16 address, u8 value) {
 				gb->apu.write_register(frame_cycle_count, address, (int)value);
 			}
 		}
-		*map(address) = value;
+		u8 *dst = map(address);
+		if (address >= ADR_VRAM && address < ADR_VRAM + SIZE_TILE_DATA && *dst != value) {
+			gb->ppu.tile_cache.invalidate(address - ADR_VRAM);
+		} else if (address >= ADR_OAM && address < ADR_OAM + SIZE_OAM) {
+			gb->ppu.obj_index_dirty = true;
+		}
+		*dst = value;
+		if (address >= ADR_RAM_INTERNAL_BANK0 && address < ADR_OAM) {
+			// a page with cached code, the store might drop that code
+			gb->block_cache.onRAMWrite(this, address);
+		} else if (address == ADR_IO + REG_BOOT) {
+			updatePages(0, 0);
+		}
 	}
 }
 
-void Memory::setROMBank(u8 bank) {
-	assert(bank * SIZE_ROM_BANK < rom_size);
+void Memory::setROMBank(u16 bank) {
+	int bank_count = rom_size / SIZE_ROM_BANK; // at least 2 (see acquireROM)
+	if (!bank_count) return; // no ROM
+	bank %= bank_count;
 	rom_bank1 = &rom[bank * SIZE_ROM_BANK];
+	updatePages(ADR_ROM_BANK1 >> PAGE_SHIFT, (ADR_VRAM >> PAGE_SHIFT) - 1);
+	gb->block_cache.resetCursor(); // next op comes from the new bank
 }
 
 void Memory::setSRAMBank(u8 bank) {
@@ -75,10 +147,103 @@ void Memory::setSRAMBank(u8 bank) {
 		LOGW("trying to set SRAM bank but no SRAM installed");
 		return;
 	}
-	assert(bank * SIZE_RAM < sram_size);
+	if (sram_size > SIZE_RAM) bank %= sram_size / SIZE_RAM;
+	else bank = 0;
 	sram_bank = &sram[bank * SIZE_RAM]; // SIZE_RAM_BANK
+	updatePages(ADR_RAM_EXTERNAL >> PAGE_SHIFT, (ADR_RAM_INTERNAL_BANK0 >> PAGE_SHIFT) - 1);
+}
+
+void Memory::updatePages(int first, int last) {
+	for (int page = first; page <= last; page++) {
+		u16 address = page << PAGE_SHIFT;
+		const u8 *read = nullptr;
+		u8 *write = nullptr; // ROM writes go to the MBC
+		if (address < ADR_ROM_BANK1) {
+			if (address < sizeof(boot_rom) && !io.BOOT) {
+				read = &boot_rom[address];
+			} else if (rom_bank0) {
+				read = &rom_bank0[address - ADR_ROM_BANK0];
+			}
+		} else if (address < ADR_VRAM) {
+			if (rom_bank1) read = &rom_bank1[address - ADR_ROM_BANK1];
+		} else if (address < ADR_RAM_EXTERNAL) {
+			read = write = &vram[address - ADR_VRAM];
+			if (address < ADR_VRAM + SIZE_TILE_DATA) write = nullptr; // tile cache
+		} else if (address < ADR_RAM_INTERNAL_BANK0) {
+			size_t offset = (sram_bank - sram) + (address - ADR_RAM_EXTERNAL);
+			if (sram && offset < sram_size && !rtc.select) read = write = &sram[offset];
+		} else if (address < ADR_OAM) { // including echo
+			int offset = (address - ADR_RAM_INTERNAL_BANK0) % SIZE_RAM;
+			read = write = &ram[offset];
+			if (gb->block_cache.isCodePage(offset >> PAGE_SHIFT)) write = nullptr;
+		}
+		if (dma_active && address < ADR_IO) read = write = nullptr;
+		if (watched_pages[page] & (WATCH_READ | WATCH_EXECUTE)) read = nullptr;
+		if (watched_pages[page] & WATCH_WRITE) write = nullptr;
+		BUS_TRACE(if (bus_trace.enabled) read = write = nullptr;)
+		read_pages[page] = read;
+		write_pages[page] = write;
+	}
 }
 
+void Memory::addWatchpoint(u16 first, u16 last, u8 flags) {
+	if (watchpoint_count == MAX_WATCHPOINTS || first > last || !flags) return;
+	Watchpoint *w = &watchpoints[watchpoint_count++];
+	w->first = first;
+	w->last = last;
+	w->flags = flags;
+	for (int page = first >> PAGE_SHIFT; page <= last >> PAGE_SHIFT; page++) {
+		watched_pages[page] |= flags;
+	}
+	if (flags & WATCH_EXECUTE) {
+		gb->block_cache.invalidateAll(); // blocks must not run over it
+		updatePages(0, PAGE_COUNT-1);
+	} else if (last >= ADR_HRAM) {
+		gb->block_cache.invalidateAll(); // compiled blocks access HRAM directly
+		updatePages(first >> PAGE_SHIFT, last >> PAGE_SHIFT);
+	} else {
+		updatePages(first >> PAGE_SHIFT, last >> PAGE_SHIFT);
+	}
+}
+
+void Memory::removeWatchpoint(int index) {
+	if (index < 0 || index >= watchpoint_count) return;
+	watchpoints[index] = watchpoints[--watchpoint_count];
+	if (watch_hit >= watchpoint_count) watch_hit = -1;
+	memset(watched_pages, 0, sizeof(watched_pages));
+	for (int i = 0; i < watchpoint_count; i++) {
+		Watchpoint *w = &watchpoints[i];
+		for (int page = w->first >> PAGE_SHIFT; page <= w->last >> PAGE_SHIFT; page++) {
+			watched_pages[page] |= w->flags;
+		}
+	}
+	updatePages(0, PAGE_COUNT-1);
+}
+
+void Memory::checkWatchpoints(u16 address, u8 flags, u8 value) {
+	if (watch_hit >= 0) return; // keep the first hit until the frontend clears it
+	for (int i = 0; i < watchpoint_count; i++) {
+		Watchpoint *w = &watchpoints[i];
+		if (!(w->flags & flags) || address < w->first || address > w->last) continue;
+		LOGI("watchpoint %c 0x%04X = 0x%02X at PC 0x%04X",
+			flags == WATCH_WRITE ? 'w' : flags == WATCH_READ ? 'r' : 'x',
+			address, value, gb->cpu.PC);
+		watch_hit = i;
+		watch_hit_address = address;
+		watch_hit_flags = flags; // runBlock stops after this op
+		watch_hit_value = value;
+		return;
+	}
+}
+
+#ifdef USE_BUS_TRACE
+void Memory::enableBusTrace(bool enabled) {
+	bus_trace.enabled = enabled;
+	updatePages(0, PAGE_COUNT-1);
+	gb->block_cache.resetCursor(); // see BlockCache::fetch
+}
+#endif
+
 void Memory::mbc0(u16 address, u8 value) {
 	switch (address>>13) {
 	case 0x1: // 0x2000 - 0x3FFF
@@ -89,12 +254,6 @@ void Memory::mbc0(u16 address, u8 value) {
 	}
 }
 
-struct MBC1State {
-	u8 lbank : 5;
-	u8 hbank : 2; // bit 5 and 6 used depending on mode
-	u8 mode  : 1; // 0: ROM banking, 1: RAM banking
-} mbc1_state = {0};
-
 void Memory::mbc1(u16 address, u8 value) {
 	switch (address>>13) {
 	case 0x0: // 0x0000 - 0x1FFF enable/disable SRAM
@@ -156,24 +315,172 @@ void Memory::mbc3(u16 address, u8 value) {
 		sram_enabled = (value&0xF) == 0xA;
 		break;
 	case 0x1: // 0x2000 - 0x3FFF switch ROM bank 1
+		value &= 0x7F;
 		if (!value) value = 1;
 		setROMBank(value);
 		break;
-	case 0x2: // 0x4000 - 0x5FFF switch SRAM bank
+	case 0x2: // 0x4000 - 0x5FFF switch SRAM bank or select RTC register
 		if (value < 4) {
-			setSRAMBank(value);
-		} // else RTC
+			rtc.select = 0;
+			if (sram_size) setSRAMBank(value);
+		} else if (value >= RTC_S && value <= RTC_DH) {
+			rtc.select = value;
+		}
+		updatePages(ADR_RAM_EXTERNAL >> PAGE_SHIFT, (ADR_RAM_INTERNAL_BANK0 >> PAGE_SHIFT) - 1);
 		break;
-	case 0x3: // 0x6000 - 0x7FFF ROM/RAM mode
+	case 0x3: // 0x6000 - 0x7FFF latch clock data
+		if (rtc.latch == 0 && value == 1) latchRTC();
+		rtc.latch = value;
 		break;
 	}
 }
 
-void Memory::DMAtoOAM(u16 src_address) {
-	// instant DMA transfer TODO: do this within 160 cycles
+void Memory::updateRTC() {
+	u64 now = gb->cpu.cycle_count;
+	if (rtc.halt) {
+		rtc.cycle = now; // counting resumes from here
+	} else {
+		u64 elapsed = (now - rtc.cycle) / CPU_FREQ_HZ;
+		rtc.seconds += elapsed;
+		rtc.cycle += elapsed * CPU_FREQ_HZ; // keep the fraction of a second
+	}
+	if (rtc.seconds >= 512*RTC_DAY_SECONDS) {
+		rtc.seconds %= 512*RTC_DAY_SECONDS;
+		rtc.carry = true;
+	}
+}
+
+void Memory::latchRTC() {
+	updateRTC();
+	u64 days = rtc.seconds / RTC_DAY_SECONDS;
+	rtc.latched[RTC_S  - RTC_S] = rtc.seconds % 60;
+	rtc.latched[RTC_M  - RTC_S] = rtc.seconds / 60 % 60;
+	rtc.latched[RTC_H  - RTC_S] = rtc.seconds / 3600 % 24;
+	rtc.latched[RTC_DL - RTC_S] = days & 0xFF;
+	rtc.latched[RTC_DH - RTC_S] = (days >> 8) | rtc.halt << 6 | rtc.carry << 7;
+	gb->idle_loop.dirty = true; // a polling loop sees new values
+}
+
+void Memory::writeRTC(u8 value) {
+	updateRTC();
+	u64 seconds = rtc.seconds % 60;
+	u64 minutes = rtc.seconds / 60 % 60;
+	u64 hours = rtc.seconds / 3600 % 24;
+	u64 days = rtc.seconds / RTC_DAY_SECONDS;
+	switch (rtc.select) {
+	case RTC_S:
+		seconds = value & 0x3F;
+		rtc.cycle = gb->cpu.cycle_count; // resets the sub-second counter
+		break;
+	case RTC_M:  minutes = value & 0x3F; break;
+	case RTC_H:  hours = value & 0x1F; break;
+	case RTC_DL: days = (days & 0x100) | value; break;
+	case RTC_DH:
+		days = (days & 0xFF) | (value & 0x01) << 8;
+		rtc.halt = value & 0x40;
+		rtc.carry = value & 0x80;
+		rtc.cycle = gb->cpu.cycle_count;
+		break;
+	}
+	rtc.seconds = ((days * 24 + hours) * 60 + minutes) * 60 + seconds;
+	rtc.latched[rtc.select - RTC_S] = value;
+}
+
+void Memory::loadRTC() {
+	int fd = open(sav_filepath, O_RDONLY);
+	if (fd < 0) return; // new game
+	u8 data[RTC_SAV_SIZE];
+	ssize_t size = pread(fd, data, sizeof(data), sram_size);
+	close(fd);
+	if (size != 44 && size != 48) return; // no clock saved
+	u32 regs[10];
+	for (int i = 0; i < 10; i++) {
+		regs[i] = data[4*i] | data[4*i+1] << 8 | data[4*i+2] << 16 | (u32)data[4*i+3] << 24;
+	}
+	u64 saved = 0;
+	for (int i = size-1; i >= 40; i--) saved = saved << 8 | data[i];
+
+	u64 days = (regs[RTC_DL - RTC_S] & 0xFF) | (regs[RTC_DH - RTC_S] & 0x01) << 8;
+	rtc.seconds = ((days * 24 + regs[RTC_H - RTC_S] % 24) * 60
+		+ regs[RTC_M - RTC_S] % 60) * 60 + regs[RTC_S - RTC_S] % 60;
+	rtc.halt = regs[RTC_DH - RTC_S] & 0x40;
+	rtc.carry = regs[RTC_DH - RTC_S] & 0x80;
+	for (int i = 0; i < 5; i++) rtc.latched[i] = regs[5 + i];
+	u64 now = (u64)time(nullptr);
+	if (!rtc.halt && now > saved) rtc.seconds += now - saved; // updateRTC wraps it
+}
+
+void Memory::saveRTC() {
+	if (!sav_filepath[0]) return;
+	updateRTC();
+	u64 days = rtc.seconds / RTC_DAY_SECONDS;
+	u32 regs[10] = {
+		(u32)(rtc.seconds % 60), (u32)(rtc.seconds / 60 % 60), (u32)(rtc.seconds / 3600 % 24),
+		(u32)(days & 0xFF), (u32)((days >> 8) | rtc.halt << 6 | rtc.carry << 7),
+	};
+	for (int i = 0; i < 5; i++) regs[5 + i] = rtc.latched[i];
+	u8 data[RTC_SAV_SIZE];
+	for (int i = 0; i < 10; i++) {
+		for (int b = 0; b < 4; b++) data[4*i+b] = regs[i] >> 8*b;
+	}
+	u64 now = (u64)time(nullptr);
+	for (int b = 0; b < 8; b++) data[40+b] = now >> 8*b;
+
+	int fd = sram_mapped ? sram_fd : open(sav_filepath, O_WRONLY | O_CREAT, 0644);
+	if (fd < 0 || pwrite(fd, data, sizeof(data), sram_size) != (ssize_t)sizeof(data)) {
+		LOGW("can't write the clock to %s", sav_filepath);
+	}
+	if (fd >= 0 && !sram_mapped) close(fd);
+}
+
+void Memory::mbc5(u16 address, u8 value) {
+	switch (address>>12) {
+	case 0x0: // 0x0000 - 0x1FFF enable/disable SRAM
+	case 0x1:
+		sram_enabled = (value&0xF) == 0xA;
+		break;
+	case 0x2: // 0x2000 - 0x2FFF ROM bank bit 0-7, bank 0 is allowed
+		mbc5_rom_bank = (mbc5_rom_bank & 0x100) | value;
+		setROMBank(mbc5_rom_bank);
+		break;
+	case 0x3: // 0x3000 - 0x3FFF ROM bank bit 8
+		mbc5_rom_bank = (mbc5_rom_bank & 0xFF) | (value & 0x01) << 8;
+		setROMBank(mbc5_rom_bank);
+		break;
+	case 0x4: // 0x4000 - 0x5FFF switch SRAM bank (bit 3: rumble motor)
+	case 0x5:
+		if (sram_size) setSRAMBank(value & 0x0F);
+		break;
+	default: break;
+	}
+}
+
+void Memory::startDMA(u16 src_address, u64 cycle) {
 	assert(sizeof(oam) == SIZE_OAM);
-	u8 *src = map(src_address);
-	memcpy((void*)&oam, src, SIZE_OAM);
+	if (dma_active) advanceDMA(cycle); // restarted
+	dma_active = true;
+	dma_source = src_address;
+	dma_begin = cycle + 4; // one M-cycle setup
+	dma_copied = 0;
+	updatePages(0, (ADR_IO >> PAGE_SHIFT) - 1);
+	gb->block_cache.resetCursor(); // see BlockCache::fetch
+}
+
+void Memory::advanceDMA(u64 cycle) {
+	if (cycle < dma_begin) return;
+	u64 due = (cycle - dma_begin) / 4 + 1;
+	int count = due < SIZE_OAM ? (int)due : SIZE_OAM;
+	for (; dma_copied < count; dma_copied++) {
+		u16 address = dma_source + dma_copied;
+		// 0xE000-0xFFFF read from WRAM
+		if (address >= ADR_RAM_INTERNAL_MIRROR) address -= ADR_RAM_INTERNAL_MIRROR - ADR_RAM_INTERNAL_BANK0;
+		((u8*)&oam)[dma_copied] = *map(address);
+		gb->ppu.obj_index_dirty = true;
+	}
+	if (dma_copied == SIZE_OAM) {
+		dma_active = false;
+		updatePages(0, (ADR_IO >> PAGE_SHIFT) - 1);
+	}
 }
 
 u8 *Memory::map(u16 address) {
@@ -181,19 +488,19 @@ u8 *Memory::map(u16 address) {
 		return &boot_rom[address];
 	} else if (address >= ADR_ROM_BANK0
 		    && address <  ADR_ROM_BANK0 + SIZE_ROM_BANK) {
-		return &rom_bank0[address - ADR_ROM_BANK0];
+		return (u8*)&rom_bank0[address - ADR_ROM_BANK0]; // only read
 	} else if (address >= ADR_ROM_BANK1
 		    && address <  ADR_ROM_BANK1 + SIZE_ROM_BANK) {
-		return &rom_bank1[address - ADR_ROM_BANK1];
+		return (u8*)&rom_bank1[address - ADR_ROM_BANK1]; // only read
 	} else if (address >= ADR_VRAM
 		    && address <  ADR_VRAM + SIZE_VRAM) {
 		return &vram[address - ADR_VRAM];
 	} else if (address >= ADR_RAM_EXTERNAL
 		    && address <  ADR_RAM_EXTERNAL + SIZE_RAM) {
+		if (rtc.select) return &rtc.latched[rtc.select - RTC_S];
 		if (!sram_size) { // TODO: exception for MBC2
-			static u8 null_byte = 0;
 			//LOGW("accessing SRAM but no SRAM installed @ 0x%04X", address);
-			return &null_byte;
+			return &unmapped;
 		}
 		assert(address - ADR_RAM_EXTERNAL < sram_size);
 		return &sram_bank[address - ADR_RAM_EXTERNAL];
@@ -208,8 +515,7 @@ u8 *Memory::map(u16 address) {
 		    && address < ADR_OAM + SIZE_OAM) {
 		return &((u8*)&oam)[address - ADR_OAM];
 	} else if (address >= ADR_EMPTY && address < ADR_IO) {
-		static u8 empty = 0;
-		return &empty;
+		return &unmapped;
 	} else if (address >= ADR_IO && address < ADR_HRAM) {
 		return &((u8*)&io)[address - ADR_IO];
 	} else if (address >= ADR_HRAM
@@ -243,32 +549,91 @@ struct CartridgeHeader { // start at 0x100 in file
 	u8 checksum_h;
 	u8 checksum_l;
 
-	bool isChecksumCorrect();
+	bool isChecksumCorrect() const;
+	size_t romSize() const; // bytes
 };
 #pragma pack(pop)
 
-bool CartridgeHeader::isChecksumCorrect() {
+bool CartridgeHeader::isChecksumCorrect() const {
 	u16 sum = 25;
-	for (u8 *b = game_title; b != &checksum_h; b++) sum += *b;
+	for (const u8 *b = game_title; b != &checksum_h; b++) sum += *b;
 	return (sum & 0xFF) == 0; // lower byte needs to be zero
 }
 
+size_t CartridgeHeader::romSize() const {
+	// 0x00: 32 KiB, doubling up to 0x08: 8 MiB, the rare odd sizes count as 32 KiB
+	if (cartridge_size > 0x08) return 2*SIZE_ROM_BANK;
+	return (size_t)(2*SIZE_ROM_BANK) << cartridge_size;
+}
+
+// ROM path with the extension of the file name replaced by .sav
+static void savFilepath(char *dst, size_t dst_size, const char *rom_filepath) {
+	const char *name = strrchr(rom_filepath, '/');
+	const char *dot = strrchr(name ? name : rom_filepath, '.');
+	int length = dot ? (int)(dot - rom_filepath) : (int)strlen(rom_filepath);
+	if (snprintf(dst, dst_size, "%.*s.sav", length, rom_filepath) >= (int)dst_size) {
+		LOGW("ROM path too long for a sav file");
+		dst[0] = '\0';
+	}
+}
+
+void Memory::mapSRAM() {
+	int fd = open(sav_filepath, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		LOGW("can't open %s", sav_filepath);
+		return;
+	}
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		// another GameBoy (or process) has it mapped: run on a copy that
+		// is never written back, that would clobber the other one's saves
+		LOGW("%s is mapped elsewhere, using a copy that isn't saved", sav_filepath);
+		sram = new u8[sram_size];
+		if (pread(fd, sram, sram_size, 0) != (ssize_t)sram_size) memset(sram, 0, sram_size);
+		sav_filepath[0] = '\0';
+		close(fd);
+		return;
+	}
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0;
+	if (ok && st.st_size == 0) { // new sav file
+		ok = ftruncate(fd, sram_size) == 0;
+	} else if (ok && (size_t)st.st_size != sram_size
+	        && !(has_rtc && (size_t)st.st_size >= sram_size + 44)) {
+		LOGW("%s has the wrong size, not mapping it", sav_filepath);
+		ok = false;
+	}
+	if (ok) {
+		void *m = mmap(nullptr, sram_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (m != MAP_FAILED) {
+			sram = (u8*)m;
+			sram_mapped = true;
+			sram_fd = fd; // keeps the lock
+			return;
+		}
+	}
+	close(fd);
+}
+
+void Memory::writeSRAM() {
+	if (!sav_filepath[0]) return;
+	if (sram_mapped) {
+		msync(sram, sram_size, MS_ASYNC); // the kernel writes it back anyway
+	} else if (sram) {
+		writeDataToFile(sav_filepath, sram, sram_size);
+	}
+	if (has_rtc) saveRTC();
+}
+
 void Memory::loadROM(const char *filepath) {
 	init(); // reinit the memory
 
-	rom = readDataFromFile(filepath, &rom_size);
+	rom = acquireROM(filepath, &rom_size); // checks the header
 	if (!rom) {
 		rom_size = 0;
 		return;
 	}
 
-	CartridgeHeader *header = (CartridgeHeader*)(rom+0x100);
-	if (!header->isChecksumCorrect()) {
-		LOGE("cartridge has incorrect checksum");
-		delete [] rom;
-		rom = nullptr;
-		return;
-	}
+	const CartridgeHeader *header = (const CartridgeHeader*)(rom+0x100);
 
 	// set MBC
 	switch (header->cartridge_type) {
@@ -292,6 +657,8 @@ void Memory::loadROM(const char *filepath) {
 		break;
 	case 0x0F: // MBC3+TIMER+BATTERY
 	case 0x10: // MBC3+TIMER+RAM+BATTERY
+		has_rtc = true;
+		// fallthrough
 	case 0x11: // MBC3
 	case 0x12: // MBC3+RAM
 	case 0x13: // MBC3+RAM+BATTERY
@@ -308,7 +675,7 @@ void Memory::loadROM(const char *filepath) {
 	case 0x1C: // MBC5+RUMBLE
 	case 0x1D: // MBC5+RUMBLE+RAM
 	case 0x1E: // MBC5+RUMBLE+RAM+BATTERY
-		LOGW("MBC5 not implemented");
+		mbc = &Memory::mbc5;
 		break;
 	case 0xFC: // POCKET CAMERA
 		LOGW("POCKET CAMERA not implemented");
@@ -324,7 +691,7 @@ void Memory::loadROM(const char *filepath) {
 		break;
 	default:
 		LOGE("unknown cartridge type 0x%02X", header->cartridge_type);
-		delete [] rom;
+		releaseROM(rom);
 		rom = nullptr;
 		return;
 	}
@@ -337,18 +704,22 @@ void Memory::loadROM(const char *filepath) {
 	case 0x01: sram_size = 0x0800; break; //  2 kB
 	case 0x02: sram_size = 0x2000; break; //  8 kB
 	case 0x03: sram_size = 0x8000; break; // 32 kB
+	case 0x04: sram_size = 0x20000; break; // 128 kB
+	case 0x05: sram_size = 0x10000; break; //  64 kB
 	default: LOGW("unknown cartridge ram type", header->ram_size);
 	}
+	if (sram_size || has_rtc) savFilepath(sav_filepath, sizeof(sav_filepath), filepath);
 	if (sram_size) {
+		if (map_sram && sav_filepath[0]) mapSRAM();
 		// check for sav file
-		char sram_filepath[256];
-		strcpy(sram_filepath, filepath);
-		strcpy(strrchr(sram_filepath, '.'), ".sav");
-		size_t sram_filesize;
-		sram = readDataFromFile(sram_filepath, &sram_filesize);
-		if (sram && sram_filesize != sram_size) {
-			delete [] sram;
-			sram = nullptr;
+		if (!sram && sav_filepath[0]) {
+			size_t sram_filesize;
+			sram = readDataFromFile(sav_filepath, &sram_filesize);
+			if (sram && sram_filesize != sram_size
+			 && !(has_rtc && sram_filesize >= sram_size + 44)) { // the clock follows
+				delete [] sram;
+				sram = nullptr;
+			}
 		}
 		// no sav file
 		if (!sram) {
@@ -356,5 +727,7 @@ void Memory::loadROM(const char *filepath) {
 			memset(sram, 0, sram_size);
 		}
 	}
+	if (has_rtc && sav_filepath[0]) loadRTC();
 	sram_bank = sram;
+	updatePages(0, PAGE_COUNT-1);
 }
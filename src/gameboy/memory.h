@@ -22,46 +22,148 @@ const int SIZE_OAM      = 0x00A0;
 const int SIZE_IO       = 0x0080;
 const int SIZE_HRAM     = 0x007F;
 
+// page tables for load8/store8
+const int PAGE_SHIFT = 8;
+const int PAGE_SIZE  = 1 << PAGE_SHIFT;
+const int PAGE_COUNT = 0x10000 >> PAGE_SHIFT;
+
 #include "oam.h"
 #include "io.h"
 
+// watchpoints trap the pages they cover, other pages keep the fast path
+const int WATCH_READ    = 0x1;
+const int WATCH_WRITE   = 0x2;
+const int WATCH_EXECUTE = 0x4; // instruction bytes fetched over the bus
+const int MAX_WATCHPOINTS = 16;
+
+struct Watchpoint {
+	u16 first, last; // inclusive
+	u8 flags; // WATCH_*
+};
+
+struct MBC1State {
+	u8 lbank : 5;
+	u8 hbank : 2; // bit 5 and 6 used depending on mode
+	u8 mode  : 1; // 0: ROM banking, 1: RAM banking
+};
+
+// MBC3 real time clock registers, selected like SRAM banks
+const u8 RTC_S  = 0x08; // seconds
+const u8 RTC_M  = 0x09; // minutes
+const u8 RTC_H  = 0x0A; // hours
+const u8 RTC_DL = 0x0B; // day counter bit 0-7
+const u8 RTC_DH = 0x0C; // bit 0: day counter bit 8, bit 6: halt, bit 7: day carry
+const u64 RTC_DAY_SECONDS = 24*60*60;
+// the clock follows the SRAM in the sav file, in the format of other
+// emulators: the 5 registers and the 5 latched ones as u32, then the UNIX
+// time of the save as u64 (u32 in older files, 44 bytes)
+const size_t RTC_SAV_SIZE = 48;
+
+// the clock isn't ticked, its time is derived from the cycle count when
+// it's latched or written (see Memory::updateRTC)
+struct MBC3RTC {
+	u8 select; // RTC_* register at 0xA000-0xBFFF, 0: SRAM
+	u8 latch; // last write to 0x6000-0x7FFF, 0 then 1 latches the time
+	u8 latched[5]; // what reads return, RTC_S to RTC_DH
+	u64 seconds; // time since day 0 at cycle
+	u64 cycle;
+	bool halt;
+	bool carry; // day counter overflowed
+};
+
 struct Memory {
 	u8 boot_rom[SIZE_BOOT_ROM]; // 0x0000
-	u8 *rom = nullptr; // 32kB, 64kB, 128kB, 256kB, 512kB and so on
+	const u8 *rom = nullptr; // shared, see rom_cache.h; 32kB, 64kB, 128kB, 256kB, 512kB and so on
 	size_t rom_size;
-	u8 *rom_bank0 = nullptr;
-	u8 *rom_bank1 = nullptr;
+	const u8 *rom_bank0 = nullptr;
+	const u8 *rom_bank1 = nullptr;
 	u8 *sram = nullptr; // 2kB, 8kB, 32kB
 	size_t sram_size;
 	u8 *sram_bank;
+	char sav_filepath[1024]; // battery save next to the ROM, empty if none
+	// back SRAM with a MAP_SHARED mapping of the sav file (set before
+	// loadROM): stores reach the file without ever blocking the emulation
+	// and survive a crash of the process. only one GameBoy can map a sav
+	// file at a time, the file stays locked (flock) while it's mapped
+	bool map_sram = false;
+	bool sram_mapped = false;
+	int sram_fd = -1; // holds the lock of the mapped sav file
 	u8 vram[SIZE_VRAM]; // 0x8000
 	u8  ram[SIZE_RAM];  // 0xC000
 	OAM oam;            // 0xFE00
 	IO io;              // 0xFF00
 	u8 hram[SIZE_HRAM]; // 0xFF80
+	u8 unmapped;        // reads and writes to nothing (no SRAM, 0xFEA0)
 
 	bool sram_enabled = false;
 
+	// host memory of each 256 byte page, nullptr: handled by map (IO, MBC,
+	// OAM, missing SRAM and WRAM pages holding cached code)
+	const u8 *read_pages[PAGE_COUNT];
+	u8 *write_pages[PAGE_COUNT];
+	void updatePages(int first, int last); // after the mapping changed
+
+	Watchpoint watchpoints[MAX_WATCHPOINTS];
+	int watchpoint_count = 0;
+	u8 watched_pages[PAGE_COUNT] = {}; // WATCH_* flags of the page
+	// first access that hit a watchpoint, the frontend stops on it and
+	// sets watch_hit back to -1 to continue
+	int watch_hit = -1; // index into watchpoints
+	u16 watch_hit_address;
+	u8 watch_hit_flags;
+	u8 watch_hit_value; // the byte written, or the one in memory before a read
+	void addWatchpoint(u16 first, u16 last, u8 flags);
+	void removeWatchpoint(int index);
+	void checkWatchpoints(u16 address, u8 flags, u8 value);
+
+#ifdef USE_BUS_TRACE
+	BusTrace bus_trace;
+	void enableBusTrace(bool enabled);
+#endif
+
+	~Memory();
 	void init();
 	void reset(); // doesn't clear ROM
 	void loadROM(const char *filepath);
+	void unloadROM(); // releases ROM and SRAM
+	// sram stays nullptr on failure, it's an unsaved copy if the file is locked
+	void mapSRAM();
+	void writeSRAM(); // to sav_filepath with the RTC, only flushes a mapped SRAM
 
 	u8 load8(u16 address);
+	u8 load8Slow(u16 address); // IO, MBC, watchpoints, DMA bus conflicts
 	void store8(u16 address, u8 value);
 
-	void DMAtoOAM(u16 src_address); // transfer 160 bytes from src_address to oam
+	// OAM DMA: one byte per M-cycle, copied in bulk whenever the CPU or the
+	// PPU could observe it, meanwhile the CPU only reaches IO and HRAM
+	bool dma_active = false;
+	u16 dma_source;
+	u64 dma_begin; // cycle the first byte is copied at
+	int dma_copied;
+	void startDMA(u16 src_address, u64 cycle); // transfer 160 bytes to oam
+	void advanceDMA(u64 cycle); // copy the bytes due until cycle
+	u64 dmaEndCycle() { return dma_begin + 4*(SIZE_OAM-1); }
 
 	// memory bank controller
 	typedef void (Memory::*MBC)(u16 address, u8 value);
 	MBC mbc; // set on loadROM
+	MBC1State mbc1_state;
+	MBC3RTC rtc;
+	bool has_rtc = false; // MBC3+TIMER, the sav file has the clock
+	u16 mbc5_rom_bank; // 9 bit
 	void mbc0(u16 address, u8 value); // dummy MBC
 	void mbc1(u16 address, u8 value);
 	void mbc2(u16 address, u8 value);
 	void mbc3(u16 address, u8 value);
 	void mbc5(u16 address, u8 value);
 
-	void setROMBank(u8 bank);
+	void setROMBank(u16 bank); // wraps around the ROM size like the MBCs do
 	void setSRAMBank(u8 bank);
+	void updateRTC(); // advance rtc.seconds to the current cycle
+	void latchRTC();
+	void writeRTC(u8 value);
+	void loadRTC(); // from the sav file, advanced by the time since the save
+	void saveRTC();
 
 	GameBoy *gb;
 private:
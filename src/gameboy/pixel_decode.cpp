@@ -0,0 +1,95 @@
+// a row is 2 bytes, the low bits first, the leftmost pixel in bit 7
+void decodeTileScalar(const u8 *data, u8 *pixels, u8 *flipped) {
+	for (int y = 0; y < 8; y++) {
+		u8 llb = data[2*y+0];
+		u8 lhb = data[2*y+1];
+		for (int x = 0; x < 8; x++) {
+			u8 pixel = ((lhb >> (7-x)) & 0x1) << 1 | ((llb >> (7-x)) & 0x1);
+			pixels[8*y+x] = pixel;
+			flipped[8*y+7-x] = pixel;
+		}
+	}
+}
+
+void expandPixelsScalar(const u8 *pixels, int count, const u32 *colors, u32 *out) {
+	for (int i = 0; i < count; i++) out[i] = colors[pixels[i] & 0x3];
+}
+
+#ifdef PIXEL_DECODE_X86
+// two rows per iteration: spread each row byte over 8 lanes, test one bit per lane
+void decodeTileSSE2(const u8 *data, u8 *pixels, u8 *flipped) {
+	__m128i rows = _mm_loadu_si128((const __m128i*)data);
+	__m128i lows  = _mm_packus_epi16(_mm_and_si128(rows, _mm_set1_epi16(0xFF)), rows);
+	__m128i highs = _mm_packus_epi16(_mm_srli_epi16(rows, 8), rows);
+	lows  = _mm_unpacklo_epi8(lows, lows);
+	highs = _mm_unpacklo_epi8(highs, highs);
+	const __m128i bits     = _mm_set_epi8(1,2,4,8,16,32,64,-128, 1,2,4,8,16,32,64,-128);
+	const __m128i bits_rev = _mm_set_epi8(-128,64,32,16,8,4,2,1, -128,64,32,16,8,4,2,1);
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i two = _mm_set1_epi8(2);
+	for (int i = 0; i < 4; i++) {
+		// rows 2i and 2i+1, 8 copies each
+		__m128i l = _mm_unpacklo_epi16(lows, lows);
+		__m128i h = _mm_unpacklo_epi16(highs, highs);
+		l = _mm_unpacklo_epi32(l, l);
+		h = _mm_unpacklo_epi32(h, h);
+		__m128i p = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(l, bits), bits), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(h, bits), bits), two));
+		__m128i f = _mm_or_si128(
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(l, bits_rev), bits_rev), one),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(h, bits_rev), bits_rev), two));
+		_mm_storeu_si128((__m128i*)&pixels[16*i], p);
+		_mm_storeu_si128((__m128i*)&flipped[16*i], f);
+		lows  = _mm_srli_si128(lows, 4); // next two rows
+		highs = _mm_srli_si128(highs, 4);
+	}
+}
+
+// the 4 colors fit in one register, pshufb looks up 4 bytes per pixel
+__attribute__((target("ssse3")))
+void expandPixelsSSSE3(const u8 *pixels, int count, const u32 *colors, u32 *out) {
+	const __m128i table = _mm_loadu_si128((const __m128i*)colors);
+	const __m128i mask = _mm_set1_epi8(0x3);
+	const __m128i channels = _mm_set_epi8(3,2,1,0, 3,2,1,0, 3,2,1,0, 3,2,1,0);
+	// 4 copies of each of 4 pixels
+	const __m128i spread0 = _mm_set_epi8(3,3,3,3, 2,2,2,2, 1,1,1,1, 0,0,0,0);
+	const __m128i spread1 = _mm_add_epi8(spread0, _mm_set1_epi8(4));
+	const __m128i spread2 = _mm_add_epi8(spread1, _mm_set1_epi8(4));
+	const __m128i spread3 = _mm_add_epi8(spread2, _mm_set1_epi8(4));
+	int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m128i p = _mm_and_si128(_mm_loadu_si128((const __m128i*)&pixels[i]), mask);
+		p = _mm_add_epi8(p, p);
+		p = _mm_add_epi8(p, p); // byte offset of the color
+		// plus the channel
+		__m128i index0 = _mm_add_epi8(_mm_shuffle_epi8(p, spread0), channels);
+		__m128i index1 = _mm_add_epi8(_mm_shuffle_epi8(p, spread1), channels);
+		__m128i index2 = _mm_add_epi8(_mm_shuffle_epi8(p, spread2), channels);
+		__m128i index3 = _mm_add_epi8(_mm_shuffle_epi8(p, spread3), channels);
+		_mm_storeu_si128((__m128i*)&out[i+0],  _mm_shuffle_epi8(table, index0));
+		_mm_storeu_si128((__m128i*)&out[i+4],  _mm_shuffle_epi8(table, index1));
+		_mm_storeu_si128((__m128i*)&out[i+8],  _mm_shuffle_epi8(table, index2));
+		_mm_storeu_si128((__m128i*)&out[i+12], _mm_shuffle_epi8(table, index3));
+	}
+	expandPixelsScalar(&pixels[i], count - i, colors, &out[i]);
+}
+#endif
+
+#ifdef PIXEL_DECODE_X86
+const DecodeTileFn decodeTile = decodeTileSSE2; // SSE2 is part of x86-64
+#else
+const DecodeTileFn decodeTile = decodeTileScalar;
+#endif
+
+static ExpandPixelsFn selectExpandPixels() {
+#ifdef PIXEL_DECODE_X86
+	__builtin_cpu_init(); // runs before main
+	if (__builtin_cpu_supports("ssse3")) return expandPixelsSSSE3;
+#endif
+	return expandPixelsScalar;
+}
+
+// picked during static initialization, not on the first call, so that
+// instances on several threads never see it change
+const ExpandPixelsFn expandPixels = selectExpandPixels();
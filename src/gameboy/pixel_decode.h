@@ -0,0 +1,21 @@
+// 2bpp tile data to pixel values 0-3 and pixel values to colors. on x86-64
+// tiles are decoded with SSE2, the SSSE3 expansion is picked at startup
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PIXEL_DECODE_X86
+#endif
+
+// 16 bytes of tile data to 64 pixel values, and mirrored in x
+typedef void (*DecodeTileFn)(const u8 *data, u8 *pixels, u8 *flipped);
+// pixel values to colors[0-3]
+typedef void (*ExpandPixelsFn)(const u8 *pixels, int count, const u32 *colors, u32 *out);
+
+extern const DecodeTileFn decodeTile;
+extern const ExpandPixelsFn expandPixels;
+
+void decodeTileScalar(const u8 *data, u8 *pixels, u8 *flipped);
+void expandPixelsScalar(const u8 *pixels, int count, const u32 *colors, u32 *out);
+#ifdef PIXEL_DECODE_X86
+void decodeTileSSE2(const u8 *data, u8 *pixels, u8 *flipped);
+void expandPixelsSSSE3(const u8 *pixels, int count, const u32 *colors, u32 *out);
+#endif
@@ -5,6 +5,8 @@ void PPU::reset() {
 	cycle_begin = 0;
 	vsync = false;
 	frame_count = 0;
+	tile_cache.invalidateAll();
+	obj_index_dirty = true;
 }
 
 // timings
@@ -18,183 +20,87 @@ const int VSYNC_CYCLES = (LCD_HEIGHT + VBLANK_LINES)
 	* (OAM_SEARCH_CYCLES + PIXEL_TRANSFER_CYCLES + HBLANK_CYCLES);
 const float VSYNC_HZ = (float)CPU_FREQ_HZ / (float)VSYNC_CYCLES;
 
+void PPU::stepTo(u64 end) {
+	IO *io = &gb->memory.io;
+	while (cycle_count < end) {
+		// after the first step of these states nothing happens until the next
+		// mode change, except for LY in V-Blank which the last step updates
+		u64 idle_end = cycle_count;
+		if (state == PPU_STATE_OAM_SEARCH && io->STAT_mode == 2) {
+			idle_end = cycle_begin + OAM_SEARCH_CYCLES - 4; // the last step selects the objs
+			if (idle_end > end) idle_end = end;
+		} else if (state == PPU_STATE_HBLANK && io->STAT_mode == 0) {
+			idle_end = cycle_begin + PIXEL_TRANSFER_CYCLES + HBLANK_CYCLES - 4;
+			if (idle_end > end) idle_end = end;
+		} else if (state == PPU_STATE_VBLANK && io->STAT_mode == 1 && !vsync) {
+			idle_end = cycle_begin + VBLANK_CYCLES - 4;
+			if (idle_end > end - 4) idle_end = end - 4;
+		}
+		if (idle_end > cycle_count) {
+			cycle_count = idle_end;
+			continue;
+		}
+		step();
+	}
+	io->STAT_coincide = io->LY == io->LYC;
+}
+
+u64 PPU::nextEventCycle() {
+	u64 cycle = cycle_count;
+	switch (state) {
+	case PPU_STATE_OAM_SEARCH:
+		cycle = cycle_begin + OAM_SEARCH_CYCLES - 4;
+		break;
+	case PPU_STATE_PIXEL_TRANSFER: // 8 pixels per step
+		cycle = cycle_count + 4 * ((LCD_WIDTH - LX + 7) / 8 - 1);
+		break;
+	case PPU_STATE_HBLANK:
+		cycle = cycle_begin + PIXEL_TRANSFER_CYCLES + HBLANK_CYCLES - 4;
+		break;
+	case PPU_STATE_VBLANK: // LY changes every line
+	{
+		const u64 line = OAM_SEARCH_CYCLES + PIXEL_TRANSFER_CYCLES + HBLANK_CYCLES;
+		cycle = cycle_begin + (cycle_count + 4 - cycle_begin + line - 1) / line * line - 4;
+	} break;
+	default:
+		return EVENT_NEVER;
+	}
+	return cycle > cycle_count ? cycle : cycle_count;
+}
+
 void PPU::step() {
-	u8 *vram = gb->memory.vram;
-	OAM *oam = &gb->memory.oam;
 	IO *io = &gb->memory.io;
 
 	cycle_count += 4;
 
-	int obj_h = io->LCDC_obj_size ? 16 : 8;
-
 	// (R) 0: HBLANK, 1: VBLANK, 2: OAM-RAM, 3: transfer data to LCD
 	switch (state) {
 	case PPU_STATE_OAM_SEARCH:
 	{
-		// find the next leftmost obj
-		int min_obj = -1;
-		int min_x = 0; // 0=invisible
-		int max_x = LCD_WIDTH+8;
-		if (line_obj_count > 0) {
-			min_x = oam->objs[line_objs[line_obj_count-1]].x;
-		}
-
-		for (int i = 0; i < ARRAY_COUNT(oam->objs); i++) {
-			if (line_obj_count >= ARRAY_COUNT(line_objs)) break;
-			if (oam->objs[i].x == 0) continue; // invisible
-			if (oam->objs[i].x < min_x) continue;
-			if (io->LY+16 >= oam->objs[i].y
-			 && io->LY+16 <  oam->objs[i].y+obj_h) {
-				if (oam->objs[i].x <= max_x) { // last wins
-					bool in_line_buf = false;
-					for (int j = 0; j < line_obj_count; j++) {
-						if (line_objs[j] == i) {
-							in_line_buf = true;
-							break;
-						}
-					}
-					if (in_line_buf) continue;
-					max_x = oam->objs[i].x;
-					min_obj = i;
-				}
-			}
-		}
-
-		// we found an obj
-		if (min_obj != -1) line_objs[line_obj_count++] = min_obj;
-
 		io->STAT_mode = 2; // OAM search
 		if (cycle_count - cycle_begin >= OAM_SEARCH_CYCLES) {
+			line_skipped = !isLineRendered(io->LY);
+			if (!line_skipped) selectLineObjs();
 			state = PPU_STATE_PIXEL_TRANSFER;
 			cycle_begin = cycle_count;
 
 			// init pixel transfer
 			LX = 0;
+			line_fifo = !scanline_renderer && !line_skipped;
 			pixel_fifo_begin = pixel_fifo_end = 0;
+			fifo_x = 0;
 			line_obj_index = 0;
 		}
 	} break;
 	case PPU_STATE_PIXEL_TRANSFER:
 	{
-		// prepare palettes for lookup
-		u8 BGP[4];
-		u8 OBP0[4];
-		u8 OBP1[4];
-		for (int i = 0; i < 4; i++) {
-			BGP[i]  = (io->BGP  >> (2*i)) & 0x03;
-			OBP0[i] = (io->OBP0 >> (2*i)) & 0x03;
-			OBP1[i] = (io->OBP1 >> (2*i)) & 0x03;
-		}
-		u8 *palettes[] = { BGP, OBP0, OBP1 };
-		// vram addresses
-		int window_map_adr = io->LCDC_window_tile_map ? 0x1C00 : 0x1800;
-		int bg_map_adr     = io->LCDC_bg_tile_map ? 0x1C00 : 0x1800;
-		int tile_adr       = io->LCDC_tile_data   ? 0x0000 : 0x1000;
-
-		int LY = io->LY;
-		assert(LY >= 0 && LY < LCD_HEIGHT);
-		assert(LX >= 0 && LX < LCD_WIDTH);
-
-		int cycle = (cycle_count - cycle_begin - 1) / 4;
-		// try to draw 8 pixels per cycle
-		for (int px = 0; px < 8; px++) {
-			// discard pixels (subtile scrolling)
-			if (LX == 0) pixel_fifo_begin += io->SCX&0x7;
-
-			if (io->LCDC_window_enable
-			 && io->LY >= io->WY && (LX+7 == io->WX || io->WX < 7))
-			{
-				pixel_fifo_begin = pixel_fifo_end; // clear fifo
-			}
-
-			// less than 8 pixels in the fifo
-			while (pixel_fifo_end - pixel_fifo_begin < 8) {
-				int fifo_pos = pixel_fifo_end - pixel_fifo_begin;
-				if (fifo_pos < 0) fifo_pos = 0;
-
-				u8 llb = 0; // line low bits
-				u8 lhb = 0; // line high bits
-
-				if (io->LCDC_window_enable
-				 && LX+7 >= io->WX && io->LY >= io->WY)
-				{
-					// fetch window tile
-					int sy = io->LY - io->WY;
-					int sx = LX+7 - io->WX + fifo_pos;
-					int ty = sy/8;
-					int tx = sx/8;
-					int ti = io->LCDC_tile_data ?
-						vram[window_map_adr+ty*0x20+tx] :
-						((s8*)vram)[window_map_adr+ty*0x20+tx]; // signed
-					// line with high and low bits
-					llb = vram[tile_adr+2*(8*ti+(sy&0x7))+0];
-					lhb = vram[tile_adr+2*(8*ti+(sy&0x7))+1];
-				} else if (io->LCDC_bg_enable) {
-					// fetch bg tile
-					int sy = (LY + io->SCY) & 0xFF;
-					int sx = (LX + io->SCX + fifo_pos) & 0xFF;
-					int ty = sy/8;
-					int tx = sx/8;
-					int ti = io->LCDC_tile_data ?
-						vram[bg_map_adr+ty*0x20+tx] :
-						((s8*)vram)[bg_map_adr+ty*0x20+tx]; // signed
-					// line with high and low bits
-					llb = vram[tile_adr+2*(8*ti+(sy&0x7))+0];
-					lhb = vram[tile_adr+2*(8*ti+(sy&0x7))+1];
-				}
-
-				// convert line to 8 pixels
-				for (int x = 0; x < 8; x++) {
-					int lb = (llb >> (7-x)) & 0x1;
-					int hb = (lhb >> (7-x)) & 0x1;
-					int pixel = (hb<<1) | lb;
-
-					pixel_fifo[pixel_fifo_end++ & 0xF] = pixel | (0<<2);
-				}
-			}
-
-			// draw objs
-			if (io->LCDC_obj_enable) {
-				while (line_obj_index < line_obj_count) {
-					OAM::OBJ *obj = &oam->objs[line_objs[line_obj_index]];
-					if (obj->x > LX+8) break; // not yet
-
-					// blit obj over the first 8 pixel in the fifo
-					int sy = (LY - obj->y) & (obj_h-1);
-					if (obj->attrib_flip_y) sy = obj_h-1-sy;
-					// line with high and low bits
-					u8 llb = vram[2*(8*obj->tile+sy)+0];
-					u8 lhb = vram[2*(8*obj->tile+sy)+1];
-
-					for (int x = 0; x < 8; x++) {
-						int shift = obj->attrib_flip_x ? x : (7-x);
-						int lb = (llb >> shift) & 0x1;
-						int hb = (lhb >> shift) & 0x1;
-						int pixel = (hb<<1) | lb;
-						if (pixel == 0) continue; // transparent
-
-						// test if obj is supposed to be behind bg
-						int bg_pixel = pixel_fifo[(pixel_fifo_begin+x)&0xF]&0x3;
-						if (obj->attrib_priority == 1 && bg_pixel > 0) continue;
-
-						pixel_fifo[(pixel_fifo_begin+x) & 0xF] = pixel
-							| ((1+obj->attrib_palette)<<2);
-					}
-
-					line_obj_index++; // next
-				}
-			}
-
-			int pixel = pixel_fifo[pixel_fifo_begin++ & 0xF];
-			framebuffer[LY*LCD_WIDTH+LX] = palettes[(pixel>>2)&0x3][pixel&0x3];
-			//if (!io->LCDC_enable) framebuffer[LY*LCD_WIDTH+LX] = 0; // TODO: hack!
-
-			LX++;
-		}
+		LX += 8; // 8 pixels per cycle
+		if (line_fifo) drawPixels(LX);
 
 		io->STAT_mode = 3; // pixel transfer
 		//if (cycle_count - cycle_begin >= PIXEL_TRANSFER_CYCLES) {
 		if (LX >= LCD_WIDTH) {
+			if (!line_fifo && !line_skipped) drawLine();
 			state = PPU_STATE_HBLANK;
 			if (io->STAT_hblank_interrupt_enable) {
 				io->IF_lcd_stat = 1;
@@ -227,8 +133,6 @@ void PPU::step() {
 					io->IF_lcd_stat = 1;
 					gb->cpu.halted = false;
 				}
-				// init oam search
-				line_obj_count = 0;
 			}
 			cycle_begin = cycle_count;
 		}
@@ -248,8 +152,6 @@ void PPU::step() {
 			cycle_begin = cycle_count;
 
 			state = PPU_STATE_OAM_SEARCH;
-			// init oam search
-			line_obj_count = 0;
 		}
 		break;
 	default: break;
@@ -257,3 +159,288 @@ void PPU::step() {
 
 	io->STAT_coincide = io->LY == io->LYC; // TODO: only when LY gets updated
 }
+
+void PPU::drawPixels(int end) {
+	u8 *vram = gb->memory.vram;
+	OAM *oam = &gb->memory.oam;
+	IO *io = &gb->memory.io;
+
+	int obj_h = io->LCDC_obj_size ? 16 : 8;
+
+	// prepare palettes for lookup
+	u8 BGP[4];
+	u8 OBP0[4];
+	u8 OBP1[4];
+	for (int i = 0; i < 4; i++) {
+		BGP[i]  = (io->BGP  >> (2*i)) & 0x03;
+		OBP0[i] = (io->OBP0 >> (2*i)) & 0x03;
+		OBP1[i] = (io->OBP1 >> (2*i)) & 0x03;
+	}
+	u8 *palettes[] = { BGP, OBP0, OBP1 };
+	// vram addresses
+	int window_map_adr = io->LCDC_window_tile_map ? 0x1C00 : 0x1800;
+	int bg_map_adr     = io->LCDC_bg_tile_map ? 0x1C00 : 0x1800;
+	int tile_adr       = io->LCDC_tile_data   ? 0x0000 : 0x1000;
+
+	int LY = io->LY;
+	assert(LY >= 0 && LY < LCD_HEIGHT);
+	assert(end <= LCD_WIDTH);
+
+	while (fifo_x < end) {
+		// discard pixels (subtile scrolling)
+		if (fifo_x == 0) pixel_fifo_begin += io->SCX&0x7;
+
+		if (io->LCDC_window_enable
+		 && io->LY >= io->WY && (fifo_x+7 == io->WX || io->WX < 7))
+		{
+			pixel_fifo_begin = pixel_fifo_end; // clear fifo
+		}
+
+		// less than 8 pixels in the fifo
+		while (pixel_fifo_end - pixel_fifo_begin < 8) {
+			int fifo_pos = pixel_fifo_end - pixel_fifo_begin;
+			if (fifo_pos < 0) fifo_pos = 0;
+
+			u8 llb = 0; // line low bits
+			u8 lhb = 0; // line high bits
+
+			if (io->LCDC_window_enable
+			 && fifo_x+7 >= io->WX && io->LY >= io->WY)
+			{
+				// fetch window tile
+				int sy = io->LY - io->WY;
+				int sx = fifo_x+7 - io->WX + fifo_pos;
+				int ty = sy/8;
+				int tx = sx/8;
+				int ti = io->LCDC_tile_data ?
+					vram[window_map_adr+ty*0x20+tx] :
+					((s8*)vram)[window_map_adr+ty*0x20+tx]; // signed
+				// line with high and low bits
+				llb = vram[tile_adr+2*(8*ti+(sy&0x7))+0];
+				lhb = vram[tile_adr+2*(8*ti+(sy&0x7))+1];
+			} else if (io->LCDC_bg_enable) {
+				// fetch bg tile
+				int sy = (LY + io->SCY) & 0xFF;
+				int sx = (fifo_x + io->SCX + fifo_pos) & 0xFF;
+				int ty = sy/8;
+				int tx = sx/8;
+				int ti = io->LCDC_tile_data ?
+					vram[bg_map_adr+ty*0x20+tx] :
+					((s8*)vram)[bg_map_adr+ty*0x20+tx]; // signed
+				// line with high and low bits
+				llb = vram[tile_adr+2*(8*ti+(sy&0x7))+0];
+				lhb = vram[tile_adr+2*(8*ti+(sy&0x7))+1];
+			}
+
+			// convert line to 8 pixels
+			for (int x = 0; x < 8; x++) {
+				int lb = (llb >> (7-x)) & 0x1;
+				int hb = (lhb >> (7-x)) & 0x1;
+				int pixel = (hb<<1) | lb;
+
+				pixel_fifo[pixel_fifo_end++ & 0xF] = pixel | (0<<2);
+			}
+		}
+
+		// draw objs
+		if (io->LCDC_obj_enable) {
+			while (line_obj_index < line_obj_count) {
+				OAM::OBJ *obj = &oam->objs[line_objs[line_obj_index]];
+				if (obj->x > fifo_x+8) break; // not yet
+
+				// blit obj over the first 8 pixel in the fifo
+				int sy = (LY - obj->y) & (obj_h-1);
+				if (obj->attrib_flip_y) sy = obj_h-1-sy;
+				// line with high and low bits
+				u8 llb = vram[2*(8*obj->tile+sy)+0];
+				u8 lhb = vram[2*(8*obj->tile+sy)+1];
+
+				for (int x = 0; x < 8; x++) {
+					int shift = obj->attrib_flip_x ? x : (7-x);
+					int lb = (llb >> shift) & 0x1;
+					int hb = (lhb >> shift) & 0x1;
+					int pixel = (hb<<1) | lb;
+					if (pixel == 0) continue; // transparent
+
+					// test if obj is supposed to be behind bg
+					int bg_pixel = pixel_fifo[(pixel_fifo_begin+x)&0xF]&0x3;
+					if (obj->attrib_priority == 1 && bg_pixel > 0) continue;
+
+					pixel_fifo[(pixel_fifo_begin+x) & 0xF] = pixel
+						| ((1+obj->attrib_palette)<<2);
+				}
+
+				line_obj_index++; // next
+			}
+		}
+
+		int pixel = pixel_fifo[pixel_fifo_begin++ & 0xF];
+		if (fifo_x >= render_left && fifo_x < render_right) {
+			framebuffer[LY*LCD_WIDTH+fifo_x] = palettes[(pixel>>2)&0x3][pixel&0x3];
+		}
+		//if (!io->LCDC_enable) framebuffer[LY*LCD_WIDTH+fifo_x] = 0; // TODO: hack!
+
+		fifo_x++;
+	}
+}
+
+static int clampRange(int value, int min, int max) {
+	return value < min ? min : value > max ? max : value;
+}
+
+void PPU::setRenderWindow(int top, int bottom, int line_step, int left, int right) {
+	render_top = clampRange(top, 0, LCD_HEIGHT);
+	render_bottom = clampRange(bottom, render_top, LCD_HEIGHT);
+	render_line_step = line_step < 1 ? 1 : line_step;
+	render_left = clampRange(left, 0, LCD_WIDTH);
+	render_right = clampRange(right, render_left, LCD_WIDTH);
+}
+
+bool PPU::isLineRendered(int ly) {
+	if (render_interval > 1 && (frame_count + 1) % render_interval != 0) return false;
+	return ly >= render_top && ly < render_bottom && (ly - render_top) % render_line_step == 0;
+}
+
+void PPU::onRegisterWrite() {
+	if (state != PPU_STATE_PIXEL_TRANSFER || line_fifo || line_skipped) return;
+	drawPixels(LX); // the pixels so far saw the old values
+	line_fifo = true;
+}
+
+// same result as drawPixels(LCD_WIDTH) for registers that don't change
+void PPU::drawLine() {
+	u8 *vram = gb->memory.vram;
+	OAM *oam = &gb->memory.oam;
+	IO *io = &gb->memory.io;
+
+	int LY = io->LY;
+	assert(LY >= 0 && LY < LCD_HEIGHT);
+
+	// colors indexed like the fifo entries: pixel | palette<<2
+	u8 colors[12];
+	for (int i = 0; i < 4; i++) {
+		colors[0+i] = (io->BGP  >> (2*i)) & 0x03;
+		colors[4+i] = (io->OBP0 >> (2*i)) & 0x03;
+		colors[8+i] = (io->OBP1 >> (2*i)) & 0x03;
+	}
+	int tile_base = io->LCDC_tile_data ? 0 : 256; // tile 0 in the cache
+	u8 line[LCD_WIDTH];
+
+	// the fifo is cleared where the window begins, for WX < 7 at every pixel
+	bool window = io->LCDC_window_enable && LY >= io->WY && io->WX < LCD_WIDTH+7;
+	bool window_every_pixel = window && io->WX < 7;
+	int window_x = !window ? LCD_WIDTH : window_every_pixel ? 0 : io->WX-7;
+
+	// background
+	if (io->LCDC_bg_enable) {
+		int sy = (LY + io->SCY) & 0xFF;
+		int map_adr = (io->LCDC_bg_tile_map ? 0x1C00 : 0x1800) + sy/8*0x20;
+		int sx = io->SCX;
+		for (int x = 0; x < window_x; ) {
+			int ti = io->LCDC_tile_data ?
+				vram[map_adr+sx/8] :
+				((s8*)vram)[map_adr+sx/8]; // signed
+			const u8 *pixels = tile_cache.row(vram, tile_base + ti, sy&0x7);
+			for (int px = sx&0x7; px < 8 && x < window_x; px++) {
+				line[x++] = pixels[px];
+			}
+			sx = (sx + 8) & 0xF8;
+		}
+	} else {
+		memset(line, 0, window_x);
+	}
+
+	// window
+	if (window) {
+		int sy = LY - io->WY;
+		int map_adr = (io->LCDC_window_tile_map ? 0x1C00 : 0x1800) + sy/8*0x20;
+		int sx = window_every_pixel ? 7 - io->WX : 0;
+		for (int x = window_x; x < LCD_WIDTH; ) {
+			int ti = io->LCDC_tile_data ?
+				vram[map_adr+sx/8] :
+				((s8*)vram)[map_adr+sx/8]; // signed
+			const u8 *pixels = tile_cache.row(vram, tile_base + ti, sy&0x7);
+			if (window_every_pixel) { // each fetch only shows its first pixel
+				line[x++] = pixels[0];
+				sx++;
+			} else {
+				for (int px = 0; px < 8 && x < LCD_WIDTH; px++) {
+					line[x++] = pixels[px];
+				}
+				sx += 8;
+			}
+		}
+	}
+
+	// objs, blitted in x order over the 8 pixels from where they begin
+	if (io->LCDC_obj_enable) {
+		int obj_h = io->LCDC_obj_size ? 16 : 8;
+		for (int i = 0; i < line_obj_count; i++) {
+			OAM::OBJ *obj = &oam->objs[line_objs[i]];
+			int begin = obj->x < 8 ? 0 : obj->x - 8;
+			if (begin >= LCD_WIDTH) break;
+			// the pixels behind a fifo clear are lost
+			int end = begin + 8;
+			if (window_every_pixel) end = begin + 1;
+			else if (window_x > begin && window_x < end) end = window_x;
+			if (end > LCD_WIDTH) end = LCD_WIDTH;
+
+			int sy = (LY - obj->y) & (obj_h-1);
+			if (obj->attrib_flip_y) sy = obj_h-1-sy;
+			const u8 *pixels = obj->attrib_flip_x ?
+				tile_cache.flippedRow(vram, obj->tile + sy/8, sy&0x7) :
+				tile_cache.row(vram, obj->tile + sy/8, sy&0x7);
+			for (int x = begin; x < end; x++) {
+				int pixel = pixels[x-begin];
+				if (pixel == 0) continue; // transparent
+				// test if obj is supposed to be behind bg
+				if (obj->attrib_priority == 1 && (line[x]&0x3) > 0) continue;
+				line[x] = pixel | ((1+obj->attrib_palette)<<2);
+			}
+		}
+	}
+
+	u8 *dst = &framebuffer[LY*LCD_WIDTH];
+	for (int x = render_left; x < render_right; x++) dst[x] = colors[line[x]];
+}
+
+void PPU::buildObjIndex() {
+	OAM *oam = &gb->memory.oam;
+	int obj_h = gb->memory.io.LCDC_obj_size ? 16 : 8;
+
+	u8 slots[LCD_HEIGHT] = {};
+	memset(obj_index_counts, 0, sizeof(obj_index_counts));
+	for (int i = 0; i < OBJ_COUNT; i++) {
+		OAM::OBJ *obj = &oam->objs[i];
+		// lines with LY+16 >= y && LY+16 < y+obj_h
+		int first = obj->y - 16;
+		int last = first + obj_h - 1;
+		if (first < 0) first = 0;
+		if (last > LCD_HEIGHT-1) last = LCD_HEIGHT-1;
+		bool visible = obj->x != 0 && obj->x <= LCD_WIDTH+8;
+		for (int ly = first; ly <= last; ly++) {
+			if (slots[ly] == OBJ_PER_LINE) continue;
+			slots[ly]++;
+			if (visible) obj_index[ly][obj_index_counts[ly]++] = i;
+		}
+	}
+	obj_index_h = obj_h;
+	obj_index_dirty = false;
+}
+
+void PPU::selectLineObjs() {
+	int obj_h = gb->memory.io.LCDC_obj_size ? 16 : 8;
+	if (obj_index_dirty || obj_index_h != obj_h) buildObjIndex();
+
+	// insertion sort by x, equal x: the higher OAM index first
+	OAM *oam = &gb->memory.oam;
+	int LY = gb->memory.io.LY;
+	line_obj_count = obj_index_counts[LY];
+	for (int i = 0; i < line_obj_count; i++) {
+		u8 obj = obj_index[LY][i];
+		int x = oam->objs[obj].x;
+		int j = i;
+		for (; j > 0 && oam->objs[line_objs[j-1]].x >= x; j--) line_objs[j] = line_objs[j-1];
+		line_objs[j] = obj;
+	}
+}
@@ -25,18 +25,56 @@ struct PPU {
 	bool vsync = false;
 	u64 frame_count = 0;
 
-	u8 line_objs[OBJ_PER_LINE];
+	u8 line_objs[OBJ_PER_LINE]; // sorted by x
 	int line_obj_count;
 	int line_obj_index;
 
+	// the first 10 objs on each line in OAM order (without those at x=0 or
+	// past the right edge, they still use up a slot), built again after
+	// OAM or the obj size changed
+	u8 obj_index[LCD_HEIGHT][OBJ_PER_LINE];
+	u8 obj_index_counts[LCD_HEIGHT];
+	int obj_index_h; // obj height it was built for
+	bool obj_index_dirty;
+
 	int LX; // current x position in line
 
+	// whole lines are drawn when mode 3 ends, unless the registers change
+	// mid-line (VRAM and OAM writes in mode 3 aren't tracked)
+	bool scanline_renderer = true;
+	bool line_fifo; // this line is drawn by the pixel FIFO
+
+	// frame skip: only every nth frame is drawn (frame_count is a multiple
+	// of n after its vsync), and of it only the lines top..bottom-1 that are
+	// line_step apart. the other pixels keep their old values, the timing,
+	// LY, STAT, IRQs and vsync don't change
+	// (the lines and columns are set with setRenderWindow, which clamps them)
+	u32 render_interval = 1;
+	int render_top = 0;
+	int render_bottom = LCD_HEIGHT;
+	int render_line_step = 1; // 2: half height observation
+	int render_left = 0; // columns left..right-1 are written
+	int render_right = LCD_WIDTH;
+	bool line_skipped = false; // nothing to draw on this line
+
 	u8 pixel_fifo[16];
 	int pixel_fifo_begin = 0;
 	int pixel_fifo_end = 0;
+	int fifo_x; // next pixel drawn by the FIFO
+
+	TileCache tile_cache;
 
 	void reset();
 	void step();
+	void onRegisterWrite(); // before LCDC, SCX, BGP, ... change
+	void buildObjIndex();
+	void selectLineObjs(); // line_objs of line LY
+	void setRenderWindow(int top, int bottom, int line_step, int left, int right);
+	bool isLineRendered(int ly);
+	void drawPixels(int end); // pixel FIFO up to x = end
+	void drawLine(); // all pixels of line LY
+	void stepTo(u64 end); // skips the idle steps in H-Blank and V-Blank
+	u64 nextEventCycle(); // when the step of the next mode change begins
 
 // private:
 	GameBoy *gb;
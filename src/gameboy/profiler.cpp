@@ -0,0 +1,68 @@
+#ifdef USE_PROFILER
+
+Profiler::~Profiler() {
+	if (cycle_counts) delete [] cycle_counts;
+}
+
+void Profiler::reset(u32 rom_size) {
+	memset(opcode_counts, 0, sizeof(opcode_counts));
+	memset(cb_opcode_counts, 0, sizeof(cb_opcode_counts));
+	memset(io_read_counts, 0, sizeof(io_read_counts));
+	memset(io_write_counts, 0, sizeof(io_write_counts));
+
+	if (!cycle_counts || this->rom_size != rom_size) {
+		if (cycle_counts) delete [] cycle_counts;
+		this->rom_size = rom_size;
+		location_count = rom_size + 0x8000 + 2;
+		cycle_counts = new u64[location_count];
+	}
+	memset(cycle_counts, 0, location_count * sizeof(u64));
+
+	location = 0;
+	weight = 0;
+	countdown = 1;
+}
+
+u32 Profiler::locate(Memory *memory, u16 pc) {
+	if (pc >= ADR_VRAM || !memory->rom) return rom_size + (pc & 0x7FFF);
+	if (pc < ADR_ROM_BANK1) return pc; // bank 0 (or the boot ROM)
+	return (u32)(memory->rom_bank1 - memory->rom) + pc - ADR_ROM_BANK1;
+}
+
+bool Profiler::describe(u32 location, u32 *bank, u16 *pc) {
+	if (location < rom_size) {
+		*bank = location / SIZE_ROM_BANK;
+		*pc = location % SIZE_ROM_BANK + (*bank ? ADR_ROM_BANK1 : 0);
+		return true;
+	}
+	if (location < haltLocation()) {
+		*bank = 0;
+		*pc = ADR_VRAM + (location - rom_size);
+		return true;
+	}
+	return false;
+}
+
+int Profiler::top(const u64 *values, u32 value_count, u32 *indices, int count) {
+	int found = 0;
+	for (u32 i = 0; i < value_count; i++) {
+		u64 value = values[i];
+		if (!value) continue;
+		if (found == count && value <= values[indices[found-1]]) continue;
+		// insertion sort into the top list
+		int j = found < count ? found++ : count-1;
+		for (; j > 0 && values[indices[j-1]] < value; j--) {
+			indices[j] = indices[j-1];
+		}
+		indices[j] = i;
+	}
+	return found;
+}
+
+u64 Profiler::totalCycles() {
+	u64 total = 0;
+	for (u32 i = 0; i < location_count; i++) total += cycle_counts[i];
+	return total;
+}
+
+#endif
@@ -0,0 +1,64 @@
+// execution profiler, compiled in with -DUSE_PROFILER
+// counts executed opcodes, cycles per (ROM bank, PC) and IO register accesses
+// with sample_interval > 1 only every nth instruction is recorded and weighted
+// by n, IO accesses, HALT and IRQ dispatch are always counted exactly
+
+#ifdef USE_PROFILER
+#define PROFILE(STATEMENT) STATEMENT
+#else
+#define PROFILE(STATEMENT)
+#endif
+
+#ifdef USE_PROFILER
+
+struct Memory;
+
+struct Profiler {
+	u32 sample_interval = 1; // 1: every instruction
+
+	u64 opcode_counts[0x100];
+	u64 cb_opcode_counts[0x100];
+	u64 io_read_counts[0x100]; // 0xFF00-0xFFFF
+	u64 io_write_counts[0x100];
+
+	// locations: ROM offsets, then PCs 0x8000-0xFFFF, then HALT and IRQ
+	u64 *cycle_counts = nullptr;
+	u32 location_count = 0;
+	u32 rom_size = 0;
+
+	// current instruction
+	u32 location = 0;
+	u32 weight = 0; // 0: not sampled
+	u32 countdown = 1;
+
+	~Profiler();
+
+	void reset(u32 rom_size);
+	u32 locate(Memory *memory, u16 pc);
+	u32 haltLocation() { return rom_size + 0x8000; }
+	u32 irqLocation() { return rom_size + 0x8001; }
+	bool describe(u32 location, u32 *bank, u16 *pc); // false: HALT or IRQ
+	int hottest(u32 *locations, int count) { return top(cycle_counts, location_count, locations, count); }
+	// indices of the largest non-zero values in descending order, returns how many
+	static int top(const u64 *values, u32 value_count, u32 *indices, int count);
+	u64 totalCycles();
+
+	void onFetch(Memory *memory, u16 pc, u8 opcode) {
+		if (--countdown) {
+			weight = 0;
+			return;
+		}
+		countdown = sample_interval;
+		weight = sample_interval;
+		opcode_counts[opcode] += weight;
+		location = locate(memory, pc);
+	}
+	void onFetchCB(u8 opcode) { cb_opcode_counts[opcode] += weight; }
+	void onHalt() { location = haltLocation(); weight = 1; }
+	void onIRQ() { location = irqLocation(); weight = 1; }
+	void onCycles(u64 cycles) {
+		if (location < location_count) cycle_counts[location] += cycles * weight;
+	}
+};
+
+#endif
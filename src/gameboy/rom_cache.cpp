@@ -0,0 +1,93 @@
+struct CachedROM {
+	u64 device, inode; // the file, independent of the path it was opened with
+	const u8 *data; // PROT_READ, never written (ROM stores go to the MBC)
+	size_t size;
+	int ref_count; // 0: free slot
+};
+
+const int ROM_CACHE_CAPACITY = 64; // distinct ROM files loaded at once
+
+static CachedROM rom_cache[ROM_CACHE_CAPACITY];
+static pthread_mutex_t rom_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const u8 *acquireROM(const char *filepath, size_t *size) {
+	int fd = open(filepath, O_RDONLY);
+	if (fd < 0) return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return nullptr;
+	}
+	if (st.st_size < 2*SIZE_ROM_BANK) { // bank 1 would fault
+		LOGE("%s is too small for a ROM", filepath);
+		close(fd);
+		return nullptr;
+	}
+
+	pthread_mutex_lock(&rom_cache_mutex);
+	CachedROM *free_slot = nullptr;
+	for (int i = 0; i < ROM_CACHE_CAPACITY; i++) {
+		CachedROM *r = &rom_cache[i];
+		if (!r->ref_count) {
+			if (!free_slot) free_slot = r;
+		} else if (r->device == (u64)st.st_dev && r->inode == (u64)st.st_ino) {
+			r->ref_count++;
+			pthread_mutex_unlock(&rom_cache_mutex);
+			close(fd);
+			*size = r->size;
+			return r->data;
+		}
+	}
+
+	const u8 *data = nullptr;
+	CartridgeHeader header;
+	if (!free_slot) {
+		LOGE("ROM cache full, can't load %s", filepath);
+	} else if (pread(fd, &header, sizeof(header), 0x100) != (ssize_t)sizeof(header)) {
+		LOGE("can't read the header of %s", filepath);
+	} else if (!header.isChecksumCorrect()) {
+		LOGE("cartridge has incorrect checksum");
+	} else if ((size_t)st.st_size < header.romSize()) { // the banks past the end would fault
+		LOGE("%s is truncated, the header declares %zu bytes", filepath, header.romSize());
+	} else {
+		void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			LOGE("can't map %s", filepath);
+		} else {
+			data = (const u8*)m;
+			free_slot->device = st.st_dev;
+			free_slot->inode = st.st_ino;
+			free_slot->data = data;
+			free_slot->size = st.st_size;
+			free_slot->ref_count = 1;
+			*size = st.st_size;
+		}
+	}
+	pthread_mutex_unlock(&rom_cache_mutex);
+	close(fd); // the mapping stays valid
+	return data;
+}
+
+void retainROM(const u8 *rom) {
+	pthread_mutex_lock(&rom_cache_mutex);
+	for (int i = 0; i < ROM_CACHE_CAPACITY; i++) {
+		CachedROM *r = &rom_cache[i];
+		if (r->ref_count && r->data == rom) {
+			r->ref_count++;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&rom_cache_mutex);
+}
+
+void releaseROM(const u8 *rom) {
+	pthread_mutex_lock(&rom_cache_mutex);
+	for (int i = 0; i < ROM_CACHE_CAPACITY; i++) {
+		CachedROM *r = &rom_cache[i];
+		if (r->ref_count && r->data == rom) {
+			if (--r->ref_count == 0) munmap((void*)r->data, r->size);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&rom_cache_mutex);
+}
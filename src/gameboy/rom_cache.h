@@ -0,0 +1,8 @@
+// ROM files are mapped read-only once and shared by every GameBoy in the
+// process, the header checksum is only checked on the first load
+
+// nullptr if the file can't be mapped, has an incorrect checksum or is
+// smaller than 32 KiB or the size its header declares
+const u8 *acquireROM(const char *filepath, size_t *size);
+void retainROM(const u8 *rom); // another user of an acquired ROM
+void releaseROM(const u8 *rom); // unmapped after the last release
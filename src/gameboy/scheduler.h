@@ -0,0 +1,47 @@
+// deadlines for the PPU and the timers: the CPU runs ahead of them until it
+// passes the earliest one (or touches their registers/memory), then
+// GameBoy::catchUp brings everything up to date and schedules again
+// the accurate mode checks the deadlines every M-cycle, the fast modes after
+// every instruction or block
+
+enum Event {
+	EVENT_PPU,   // next PPU mode change (IRQs, frame end)
+	EVENT_TIMER, // next TIMA overflow
+	EVENT_DMA,   // end of an OAM DMA transfer, the CPU gets the bus back
+	EVENT_SYNC,  // an IO register was written, deadlines might have moved
+	// the ones below only show in registers that catch up when read, so
+	// they don't count for next, but a polling loop reading them can't be
+	// skipped past them (see GameBoy::skipIdleLoop)
+	EVENT_DIV,   // next DIV increment
+	EVENT_APU,   // next tick of the APU frame sequencer (length, sweep, envelope)
+	EVENT_COUNT
+};
+const int EVENT_CATCH_UP_COUNT = EVENT_DIV; // the events that count for next
+
+const u64 EVENT_NEVER = ~(u64)0;
+
+struct Scheduler {
+	u64 deadlines[EVENT_COUNT]; // catch up once cpu.cycle_count is greater
+	u64 next = 0; // the earliest deadline
+
+	void reset() {
+		for (int i = 0; i < EVENT_COUNT; i++) deadlines[i] = EVENT_NEVER;
+		next = 0;
+	}
+	void schedule(Event event, u64 cycle) {
+		deadlines[event] = cycle;
+		if (event < EVENT_CATCH_UP_COUNT && cycle < next) next = cycle;
+	}
+	void updateNext() {
+		next = EVENT_NEVER;
+		for (int i = 0; i < EVENT_CATCH_UP_COUNT; i++) {
+			if (deadlines[i] < next) next = deadlines[i];
+		}
+	}
+};
+
+// accesses that can observe the PPU or the timers let them catch up first
+static inline bool needsSync(u16 adr) {
+	return (adr >= ADR_VRAM && adr < ADR_RAM_EXTERNAL)
+	    || (adr >= ADR_OAM && adr < ADR_HRAM) || adr == ADR_IE;
+}
@@ -0,0 +1,13 @@
+TileCache::~TileCache() {
+	if (tiles) delete tiles;
+}
+
+void TileCache::allocate() {
+	tiles = new DecodedTiles;
+	memset(tiles->dirty, 1, sizeof(tiles->dirty));
+}
+
+void TileCache::decode(const u8 *vram, int tile) {
+	decodeTile(&vram[16*tile], tiles->pixels[tile][0], tiles->flipped[tile][0]);
+	tiles->dirty[tile] = false;
+}
@@ -0,0 +1,35 @@
+// tile data 0x8000-0x97FF decoded to pixel values 0-3, read by the line
+// renderer and the debug viewers. stores to the tile data mark a tile dirty
+// (Memory::store8), it's decoded again on its next read
+
+const int TILE_COUNT     = 384;
+const int SIZE_TILE_DATA = 16*TILE_COUNT;
+
+struct DecodedTiles {
+	u8 pixels[TILE_COUNT][8][8];
+	u8 flipped[TILE_COUNT][8][8]; // mirrored in x, for objs
+	bool dirty[TILE_COUNT];
+};
+
+struct TileCache {
+	// allocated on the first read with every tile dirty, so a PPU that
+	// isn't drawing (or was just forked) doesn't carry 48 KiB of pixels
+	DecodedTiles *tiles = nullptr;
+
+	~TileCache();
+
+	void invalidate(u16 offset) { if (tiles && offset < SIZE_TILE_DATA) tiles->dirty[offset >> 4] = true; } // VRAM offset
+	void invalidateAll() { if (tiles) memset(tiles->dirty, 1, sizeof(tiles->dirty)); }
+	const u8 *row(const u8 *vram, int tile, int y) {
+		if (!tiles) allocate();
+		if (tiles->dirty[tile]) decode(vram, tile);
+		return tiles->pixels[tile][y];
+	}
+	const u8 *flippedRow(const u8 *vram, int tile, int y) {
+		if (!tiles) allocate();
+		if (tiles->dirty[tile]) decode(vram, tile);
+		return tiles->flipped[tile][y];
+	}
+	void allocate();
+	void decode(const u8 *vram, int tile);
+};
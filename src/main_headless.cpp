@@ -0,0 +1,345 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+
+// Gb_Apu
+#include <Gb_Apu.h>
+#include <Multi_Buffer.h>
+
+#include "system/defines.h"
+#include "system/log.h"
+#include "system/files.h"
+
+#include "gameboy/gbcore.h"
+
+#include "system/log.cpp"
+#include "system/files.cpp"
+
+// the emulation core is linked in from libGbCore.a
+
+static void printUsage(const char *name) {
+	fprintf(stderr, "usage: %s [options] rom.gb [frames]\n", name);
+	fprintf(stderr, "  -b file  boot rom (default: dmg_rom.bin, skipped if missing)\n");
+	fprintf(stderr, "  -a       run the APU and discard its samples\n");
+	fprintf(stderr, "  -f       fast mode (whole instructions, batched PPU and timers)\n");
+	fprintf(stderr, "  -t       block mode (whole ROM blocks as threaded code)\n");
+	fprintf(stderr, "  -j       block mode with hot blocks compiled to x86-64\n");
+	fprintf(stderr, "  -i       skip idle polling loops (with -f or -t)\n");
+	fprintf(stderr, "  -k n     draw only every nth frame, the others keep the timing\n");
+	fprintf(stderr, "  -c spec  draw only part of each frame, spec: top,bottom,line_step,left,right\n");
+	fprintf(stderr, "  -l       draw every line through the pixel FIFO (no scanline renderer)\n");
+	fprintf(stderr, "  -s       map battery SRAM to the .sav file (written as it changes)\n");
+	fprintf(stderr, "  -w spec  stop at a watchpoint, spec: C000[-C0FF][:rwx] (default :w)\n");
+	fprintf(stderr, "  -p n     profile every nth instruction (built with USE_PROFILER)\n");
+	fprintf(stderr, "  -r file  write the last bus accesses (built with USE_BUS_TRACE)\n");
+	fprintf(stderr, "  -o file  write the last frame as PGM image\n");
+	fprintf(stderr, "  -F n     fork n times after the run, time it and check a fork runs on alike\n");
+}
+
+// FNV-1a
+static u64 hashFramebuffer(const u8 *pixels, size_t size) {
+	u64 hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= pixels[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+#ifdef USE_PROFILER
+static void printProfile(GameBoy *gb) {
+	Profiler *profiler = &gb->cpu.profiler;
+	u64 total = profiler->totalCycles();
+	if (!total) return;
+	printf("profile (every %u. instruction):\n", profiler->sample_interval);
+
+	printf("  cycles by location:\n");
+	u32 indices[32];
+	int count = profiler->hottest(indices, ARRAY_COUNT(indices));
+	for (int i = 0; i < count; i++) {
+		u32 location = indices[i];
+		u64 cycles = profiler->cycle_counts[location];
+		double percent = 100.0 * (double)cycles / (double)total;
+		u32 bank;
+		u16 pc;
+		if (!profiler->describe(location, &bank, &pc)) {
+			printf("    %-10s %12llu %5.1f%%\n", location == profiler->haltLocation() ? "HALT" : "IRQ",
+				(unsigned long long)cycles, percent);
+		} else if (location < profiler->rom_size) {
+			printf("    %02X:%04X    %12llu %5.1f%%  %s\n", bank, pc, (unsigned long long)cycles, percent,
+				gb->cpu.instruction_infos[gb->memory.rom[location]].mnemonic);
+		} else {
+			printf("    %04X       %12llu %5.1f%%\n", pc, (unsigned long long)cycles, percent);
+		}
+	}
+
+	printf("  opcodes:\n");
+	count = Profiler::top(profiler->opcode_counts, 0x100, indices, 16);
+	for (int i = 0; i < count; i++) {
+		printf("    %02X %-14s %12llu\n", indices[i], gb->cpu.instruction_infos[indices[i]].mnemonic,
+			(unsigned long long)profiler->opcode_counts[indices[i]]);
+	}
+	count = Profiler::top(profiler->cb_opcode_counts, 0x100, indices, 16);
+	for (int i = 0; i < count; i++) {
+		printf("    CB %02X           %12llu\n", indices[i],
+			(unsigned long long)profiler->cb_opcode_counts[indices[i]]);
+	}
+
+	printf("  IO registers (reads, writes):\n");
+	for (int i = 0; i < 0x100; i++) {
+		if (!profiler->io_read_counts[i] && !profiler->io_write_counts[i]) continue;
+		printf("    FF%02X %12llu %12llu\n", i, (unsigned long long)profiler->io_read_counts[i],
+			(unsigned long long)profiler->io_write_counts[i]);
+	}
+}
+#endif
+
+// first[-last][:rwx], addresses in hex
+static bool parseWatchpoint(const char *spec, Watchpoint *w) {
+	char *end;
+	long first = strtol(spec, &end, 16);
+	long last = first;
+	if (*end == '-') last = strtol(end+1, &end, 16);
+	w->flags = WATCH_WRITE;
+	if (*end == ':') {
+		w->flags = 0;
+		for (end++; *end; end++) {
+			if (*end == 'r') w->flags |= WATCH_READ;
+			else if (*end == 'w') w->flags |= WATCH_WRITE;
+			else if (*end == 'x') w->flags |= WATCH_EXECUTE;
+			else return false;
+		}
+	}
+	if (*end || first < 0 || last > 0xFFFF || first > last || !w->flags) return false;
+	w->first = (u16)first;
+	w->last = (u16)last;
+	return true;
+}
+
+// up to the next vsync, then the audio of the frame is discarded
+// false: an error or a watchpoint stopped it before
+static bool runFrame(GameBoy *gb) {
+	gb->frame_begin_cycle_count = gb->cpu.cycle_count;
+	u64 frame_end = gb->ppu.frame_count + 1;
+	while (gb->ppu.frame_count < frame_end) {
+		if (gb->cpu.DEBUG_not_implemented_error || gb->memory.watch_hit >= 0) return false;
+		gb->stepBlock();
+	}
+	gb->endAudioFrame();
+	blip_sample_t out_buf[4096];
+	while (gb->audio_buffer.read_samples(out_buf, ARRAY_COUNT(out_buf))) {}
+	return true;
+}
+
+static bool writePGM(const char *filepath, const u8 *framebuffer) {
+	FILE *file = fopen(filepath, "wb");
+	if (!file) return false;
+	fprintf(file, "P5\n%d %d\n255\n", LCD_WIDTH, LCD_HEIGHT);
+	const u8 shades[4] = {0xFF, 0xAA, 0x55, 0x00};
+	for (int i = 0; i < LCD_WIDTH*LCD_HEIGHT; i++) {
+		fputc(shades[framebuffer[i]&0x3], file);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	const char *rom_filepath = nullptr;
+	const char *boot_rom_filepath = "dmg_rom.bin";
+	const char *image_filepath = nullptr;
+	const char *trace_filepath = nullptr;
+	bool audio_enabled = false;
+	bool fast_mode = false;
+	bool block_mode = false;
+	bool jit_mode = false;
+	bool idle_loop_skip = false;
+	bool map_sram = false;
+	bool scanline_renderer = true;
+	long render_interval = 1;
+	int render_window[5] = {0, LCD_HEIGHT, 1, 0, LCD_WIDTH}; // clamped by setRenderWindow
+	Watchpoint watchpoints[MAX_WATCHPOINTS];
+	int watchpoint_count = 0;
+	long profile_interval = 1;
+	long frames = 60;
+	long fork_count = 0;
+
+	int positional = 0;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-b") && i+1 < argc) {
+			boot_rom_filepath = argv[++i];
+		} else if (!strcmp(argv[i], "-a")) {
+			audio_enabled = true;
+		} else if (!strcmp(argv[i], "-f")) {
+			fast_mode = true;
+		} else if (!strcmp(argv[i], "-t")) {
+			block_mode = true;
+		} else if (!strcmp(argv[i], "-j")) {
+			block_mode = true;
+			jit_mode = true;
+#ifndef CPU_JIT_X86
+			LOGW("no JIT for this host, -j runs the threaded code");
+#endif
+		} else if (!strcmp(argv[i], "-i")) {
+			idle_loop_skip = true;
+		} else if (!strcmp(argv[i], "-w") && i+1 < argc) {
+			if (watchpoint_count == MAX_WATCHPOINTS
+			 || !parseWatchpoint(argv[++i], &watchpoints[watchpoint_count++])) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "-k") && i+1 < argc) {
+			render_interval = strtol(argv[++i], NULL, 10);
+			if (render_interval < 1) render_interval = 1;
+		} else if (!strcmp(argv[i], "-c") && i+1 < argc) {
+			int *w = render_window;
+			if (sscanf(argv[++i], "%d,%d,%d,%d,%d", &w[0], &w[1], &w[2], &w[3], &w[4]) != 5) {
+				printUsage(argv[0]);
+				return 1;
+			}
+		} else if (!strcmp(argv[i], "-l")) {
+			scanline_renderer = false;
+		} else if (!strcmp(argv[i], "-s")) {
+			map_sram = true;
+		} else if (!strcmp(argv[i], "-p") && i+1 < argc) {
+			profile_interval = strtol(argv[++i], NULL, 10);
+			if (profile_interval < 1) profile_interval = 1;
+#ifndef USE_PROFILER
+			LOGW("built without USE_PROFILER, -p has no effect");
+#endif
+		} else if (!strcmp(argv[i], "-r") && i+1 < argc) {
+			trace_filepath = argv[++i];
+#ifndef USE_BUS_TRACE
+			LOGW("built without USE_BUS_TRACE, -r %s has no effect", trace_filepath);
+#endif
+		} else if (!strcmp(argv[i], "-o") && i+1 < argc) {
+			image_filepath = argv[++i];
+		} else if (!strcmp(argv[i], "-F") && i+1 < argc) {
+			fork_count = strtol(argv[++i], NULL, 10);
+		} else if (argv[i][0] == '-') {
+			printUsage(argv[0]);
+			return 1;
+		} else if (positional == 0) {
+			rom_filepath = argv[i];
+			positional++;
+		} else if (positional == 1) {
+			frames = strtol(argv[i], NULL, 10);
+			positional++;
+		}
+	}
+	if (!rom_filepath) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	GameBoy *gb = new GameBoy();
+
+	size_t boot_rom_size = 0;
+	u8 *boot_rom = readDataFromFile(boot_rom_filepath, &boot_rom_size);
+	bool has_boot_rom = boot_rom && boot_rom_size == sizeof(gb->memory.boot_rom);
+	if (has_boot_rom) {
+		memcpy(gb->memory.boot_rom, boot_rom, boot_rom_size);
+	}
+	if (boot_rom) delete [] boot_rom;
+
+	gb->init();
+	gb->audio_enabled = audio_enabled;
+	gb->fast_mode = fast_mode;
+	gb->block_mode = block_mode;
+	gb->jit_mode = jit_mode;
+	gb->idle_loop_skip = idle_loop_skip;
+	gb->memory.map_sram = map_sram;
+	gb->ppu.scanline_renderer = scanline_renderer;
+	gb->ppu.render_interval = (u32)render_interval;
+	gb->ppu.setRenderWindow(render_window[0], render_window[1], render_window[2],
+		render_window[3], render_window[4]);
+	gb->loadROM(rom_filepath);
+	if (!gb->memory.rom) {
+		LOGE("could not load ROM %s", rom_filepath);
+		return 1;
+	}
+	if (!has_boot_rom) gb->skipBootROM();
+	for (int i = 0; i < watchpoint_count; i++) {
+		Watchpoint *w = &watchpoints[i];
+		gb->memory.addWatchpoint(w->first, w->last, w->flags);
+	}
+#ifdef USE_PROFILER
+	gb->cpu.profiler.sample_interval = (u32)profile_interval;
+#endif
+#ifdef USE_BUS_TRACE
+	if (trace_filepath) gb->memory.enableBusTrace(true);
+#endif
+
+	auto time_begin = std::chrono::steady_clock::now();
+	for (long frame = 0; frame < frames; frame++) {
+		runFrame(gb);
+		if (gb->cpu.DEBUG_not_implemented_error) {
+			LOGE("stopped at frame %ld PC 0x%04X", frame, gb->cpu.PC);
+			break;
+		}
+		if (gb->memory.watch_hit >= 0) {
+			u8 flags = gb->memory.watch_hit_flags;
+			printf("watchpoint: %c 0x%04X = 0x%02X at frame %ld PC 0x%04X\n",
+				flags == WATCH_WRITE ? 'w' : flags == WATCH_READ ? 'r' : 'x',
+				gb->memory.watch_hit_address, gb->memory.watch_hit_value, frame, gb->cpu.PC);
+			break;
+		}
+	}
+	auto time_end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(time_end - time_begin).count();
+
+	u64 hash = hashFramebuffer(gb->ppu.framebuffer, sizeof(gb->ppu.framebuffer));
+	printf("frames: %llu\n", (unsigned long long)gb->ppu.frame_count);
+	printf("cycles: %llu\n", (unsigned long long)gb->cpu.cycle_count);
+	printf("time: %.3f s\n", seconds);
+	printf("speed: %.2f MHz (%.1fx)\n",
+		(double)gb->cpu.cycle_count / seconds / 1e6,
+		(double)gb->cpu.cycle_count / seconds / CPU_FREQ_HZ);
+	printf("framebuffer: %016llx\n", (unsigned long long)hash);
+	if (jit_mode) {
+		printf("jit: %llu blocks compiled, %llu flushes\n", (unsigned long long)gb->jit.DEBUG_compile_count,
+			(unsigned long long)gb->jit.DEBUG_flush_count);
+	}
+	if (idle_loop_skip) {
+		printf("idle skipped: %llu cycles\n", (unsigned long long)gb->idle_loop.skipped_cycles);
+	}
+#ifdef USE_PROFILER
+	printProfile(gb);
+#endif
+	if (fork_count > 0) {
+		auto fork_begin = std::chrono::steady_clock::now();
+		GameBoy *child = nullptr;
+		for (long i = 0; i < fork_count; i++) {
+			if (child) delete child;
+			child = gb->fork();
+		}
+		auto fork_end = std::chrono::steady_clock::now();
+		double us = std::chrono::duration<double, std::micro>(fork_end - fork_begin).count();
+		printf("fork: %.1f us\n", us / (double)fork_count);
+
+		// more frames in both have to end the same, the child's first
+		// one sets up its audio buffer
+		for (int i = 0; i < 3; i++) {
+			runFrame(gb);
+			runFrame(child);
+		}
+		bool same = gb->cpu.cycle_count == child->cpu.cycle_count
+			&& !memcmp(gb->ppu.framebuffer, child->ppu.framebuffer, sizeof(gb->ppu.framebuffer));
+		printf("fork frame: %s\n", same ? "same" : "DIFFERENT");
+		delete child;
+	}
+#ifdef USE_BUS_TRACE
+	// also after DEBUG_not_implemented_error or a watchpoint stopped the run
+	if (trace_filepath && !gb->memory.bus_trace.write(trace_filepath)) {
+		LOGE("could not write bus trace %s", trace_filepath);
+	}
+#endif
+
+	if (image_filepath && !writePGM(image_filepath, gb->ppu.framebuffer)) {
+		LOGE("could not write %s", image_filepath);
+	}
+
+	delete gb;
+	return 0;
+}
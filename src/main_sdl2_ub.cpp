@@ -3,6 +3,19 @@
 #include <stdarg.h>
 #include <ctime>
 
+// ROM cache and mapped SRAM
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// SIMD pixel decoding
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
 // SDL2
 #include <SDL.h>
 #ifdef USE_GLEW
@@ -40,10 +53,7 @@
 
 #include "audio.h"
 
-#include "gameboy/cpu.h"
-#include "gameboy/ppu.h"
-#include "gameboy/memory.h"
-#include "gameboy/gameboy.h"
+#include "gameboy/gbcore.h"
 
 #include "gui/memory_editor.h"
 #include "app.h"
@@ -58,8 +68,18 @@
 #include "video/texture.cpp"
 
 #include "gameboy/cpu.cpp"
+#include "gameboy/cpu_tables.cpp"
+#include "gameboy/cpu_switch.cpp"
+#include "gameboy/cpu_threaded.cpp"
+#include "gameboy/cpu_jit.cpp"
+#include "gameboy/block_cache.cpp"
+#include "gameboy/profiler.cpp"
+#include "gameboy/bus_trace.cpp"
+#include "gameboy/pixel_decode.cpp"
+#include "gameboy/tile_cache.cpp"
 #include "gameboy/ppu.cpp"
 #include "gameboy/memory.cpp"
+#include "gameboy/rom_cache.cpp"
 #include "gameboy/gameboy.cpp"
 
 #include "app.cpp"
@@ -205,14 +225,14 @@ int main(int argc, char *argv[]) {
 	app = new App();
 
 	// init default key bindings
-	keyboard.bind(SDL_SCANCODE_A, &app->gb.button_a);
-	keyboard.bind(SDL_SCANCODE_S, &app->gb.button_b);
-	keyboard.bind(SDL_SCANCODE_RETURN, &app->gb.button_start);
-	keyboard.bind(SDL_SCANCODE_BACKSPACE, &app->gb.button_select);
-	keyboard.bind(SDL_SCANCODE_LEFT,  &app->gb.button_left);
-	keyboard.bind(SDL_SCANCODE_RIGHT, &app->gb.button_right);
-	keyboard.bind(SDL_SCANCODE_UP,    &app->gb.button_up);
-	keyboard.bind(SDL_SCANCODE_DOWN,  &app->gb.button_down);
+	keyboard.bind(SDL_SCANCODE_A, &app->button_a);
+	keyboard.bind(SDL_SCANCODE_S, &app->button_b);
+	keyboard.bind(SDL_SCANCODE_RETURN, &app->button_start);
+	keyboard.bind(SDL_SCANCODE_BACKSPACE, &app->button_select);
+	keyboard.bind(SDL_SCANCODE_LEFT,  &app->button_left);
+	keyboard.bind(SDL_SCANCODE_RIGHT, &app->button_right);
+	keyboard.bind(SDL_SCANCODE_UP,    &app->button_up);
+	keyboard.bind(SDL_SCANCODE_DOWN,  &app->button_down);
 
 	// video settings
 	app->video.width = 1280;
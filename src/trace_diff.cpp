@@ -0,0 +1,76 @@
+// finds the first divergence between two bus traces (gbemu-headless -r)
+// accesses are matched by their index since the trace was enabled, cycles
+// are only compared with -c (the fast modes stamp the instruction start)
+#include <cstdio>
+#include <cstring>
+
+#include "system/defines.h"
+
+#include "gameboy/bus_trace.h"
+
+struct Trace {
+	u64 first; // index of accesses[0]
+	u64 count;
+	BusAccess *accesses;
+};
+
+static bool readTrace(const char *filepath, Trace *trace) {
+	FILE *file = fopen(filepath, "rb");
+	if (!file) return false;
+	char magic[8];
+	bool ok = fread(magic, 1, 8, file) == 8 && !memcmp(magic, "GBTRACE1", 8)
+		&& fread(&trace->first, sizeof(trace->first), 1, file) == 1;
+	if (ok) {
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file) - 16;
+		trace->count = size / sizeof(BusAccess);
+		trace->accesses = new BusAccess[trace->count];
+		fseek(file, 16, SEEK_SET);
+		ok = fread(trace->accesses, sizeof(BusAccess), trace->count, file) == trace->count;
+	}
+	fclose(file);
+	return ok;
+}
+
+static void printAccess(const char *prefix, u64 index, const BusAccess *a) {
+	printf("%s #%llu cycle %llu PC 0x%04X %c 0x%04X = 0x%02X\n", prefix,
+		(unsigned long long)index, (unsigned long long)a->cycle, a->pc,
+		a->flags & BUS_ACCESS_WRITE ? 'W' : 'R', a->address, a->value);
+}
+
+int main(int argc, char *argv[]) {
+	bool compare_cycles = argc == 4 && !strcmp(argv[1], "-c");
+	if (argc != 3 + compare_cycles) {
+		fprintf(stderr, "usage: %s [-c] a.trace b.trace\n", argv[0]);
+		fprintf(stderr, "  -c  cycles have to match as well\n");
+		return 2;
+	}
+	Trace a, b;
+	const char *path_a = argv[1 + compare_cycles];
+	const char *path_b = argv[2 + compare_cycles];
+	if (!readTrace(path_a, &a)) { fprintf(stderr, "could not read %s\n", path_a); return 2; }
+	if (!readTrace(path_b, &b)) { fprintf(stderr, "could not read %s\n", path_b); return 2; }
+
+	// the overlap of both rings
+	u64 begin = a.first > b.first ? a.first : b.first;
+	u64 end_a = a.first + a.count, end_b = b.first + b.count;
+	u64 end = end_a < end_b ? end_a : end_b;
+	for (u64 i = begin; i < end; i++) {
+		const BusAccess *x = &a.accesses[i - a.first];
+		const BusAccess *y = &b.accesses[i - b.first];
+		if (x->pc == y->pc && x->address == y->address && x->value == y->value
+		 && x->flags == y->flags && (!compare_cycles || x->cycle == y->cycle)) continue;
+		if (i == begin && begin > 0) printf("(the rings only overlap from here, trace fewer frames if the traces are out of step)\n");
+		u64 context = i - begin < 8 ? i - begin : 8;
+		for (u64 j = i - context; j < i; j++) printAccess(" ", j, &a.accesses[j - a.first]);
+		printAccess("<", i, x);
+		printAccess(">", i, y);
+		return 1;
+	}
+	if (end_a != end_b) {
+		printf("identical up to #%llu, then one trace ends\n", (unsigned long long)end);
+		return 1;
+	}
+	printf("identical (#%llu to #%llu)\n", (unsigned long long)begin, (unsigned long long)end);
+	return 0;
+}